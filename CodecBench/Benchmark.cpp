@@ -0,0 +1,136 @@
+#include "Benchmark.h"
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <utility>
+#include "Logger.h"
+
+namespace {
+    std::atomic<std::uint64_t> allocationCount{ 0U };
+    std::atomic<std::uint64_t> allocatedBytes{ 0U };
+
+    void *countedAllocate(std::size_t size) {
+        allocationCount.fetch_add(1U, std::memory_order_relaxed);
+        allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        if (auto const p = std::malloc(size == 0U ? 1U : size)) {
+            return p;
+        }
+        throw std::bad_alloc{ };
+    }
+
+    void writeString(std::ostream &os, std::string const &str) {
+        os << '"';
+        for (auto const c : str) {
+            if (c == '"' || c == '\\') {
+                os << '\\';
+            }
+            os << c;
+        }
+        os << '"';
+    }
+} // END of anonymous namespace
+
+void *operator new(std::size_t size) {
+    return countedAllocate(size);
+}
+
+void *operator new[](std::size_t size) {
+    return countedAllocate(size);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace bench {
+    std::uint64_t getAllocationCount() {
+        return allocationCount.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t getAllocatedBytes() {
+        return allocatedBytes.load(std::memory_order_relaxed);
+    }
+
+    Runner::Runner(std::chrono::milliseconds minTime, std::string filter)
+        : minTime_{ minTime }, filter_{ std::move(filter) }, results_{ } {
+        LOG_SCOPE;
+    }
+
+    void Runner::run(std::string operation, std::string messageType, std::size_t parameter, std::size_t frameBytes,
+                     Operation const &op) {
+        LOG_SCOPE;
+        auto name = operation + '/' + messageType + '/' + std::to_string(parameter);
+        if (name.find(filter_) == std::string::npos) {
+            return;
+        }
+
+        using Clock = std::chrono::steady_clock;
+        op(); // warm up: fills the caches and lets lazily created statics allocate outside of the measurement
+        auto batch = static_cast<std::uint64_t>(1U);
+        for (;;) {
+            auto const allocationsBefore = getAllocationCount();
+            auto const bytesBefore = getAllocatedBytes();
+            auto const start = Clock::now();
+            for (auto i = static_cast<std::uint64_t>(0U); i < batch; ++i) {
+                op();
+            }
+            auto const elapsed = Clock::now() - start;
+            auto const allocations = getAllocationCount() - allocationsBefore;
+            auto const bytes = getAllocatedBytes() - bytesBefore;
+
+            if (elapsed >= minTime_) {
+                auto const seconds = std::chrono::duration<double>{ elapsed }.count();
+                auto const ops = static_cast<double>(batch);
+                results_.push_back(Result{ std::move(name), std::move(operation), std::move(messageType), parameter, frameBytes,
+                                           batch, seconds, ops / seconds, ops * static_cast<double>(frameBytes) / seconds,
+                                           static_cast<double>(allocations) / ops, static_cast<double>(bytes) / ops });
+                return;
+            }
+            batch *= 2U;
+        }
+    }
+
+    std::vector<Result> const &Runner::getResults() const {
+        LOG_SCOPE;
+        return results_;
+    }
+
+    void Runner::writeJson(std::ostream &os) const {
+        LOG_SCOPE;
+        auto const flags = os.flags();
+        os << std::setprecision(6) << "{\n  \"minTimeMs\": " << minTime_.count() << ",\n  \"benchmarks\": [";
+        auto first = true;
+        for (auto const &result : results_) {
+            os << (first ? "\n" : ",\n") << "    {\"name\": ";
+            writeString(os, result.name);
+            os << ", \"operation\": ";
+            writeString(os, result.operation);
+            os << ", \"messageType\": ";
+            writeString(os, result.messageType);
+            os << ", \"parameter\": " << result.parameter
+               << ", \"frameBytes\": " << result.frameBytes
+               << ", \"iterations\": " << result.iterations
+               << ", \"seconds\": " << result.seconds
+               << ", \"messagesPerSecond\": " << result.messagesPerSecond
+               << ", \"bytesPerSecond\": " << result.bytesPerSecond
+               << ", \"allocationsPerOp\": " << result.allocationsPerOp
+               << ", \"bytesAllocatedPerOp\": " << result.bytesAllocatedPerOp << '}';
+            first = false;
+        }
+        os << "\n  ]\n}\n";
+        os.flags(flags);
+    }
+} // END of namespace bench
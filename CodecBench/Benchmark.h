@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace bench {
+    // what one benchmark measured. the rates are per second of wall clock time spent in the timed loop.
+    struct Result final {
+        using this_type = Result;
+        std::string name; // e.g. "encode/sendMsgUsr/1024"
+        std::string operation; // "encode" or "decode"
+        std::string messageType; // utils::getName of the message's type
+        std::size_t parameter; // the records or text bytes the message was built with, 0 if it has neither
+        std::size_t frameBytes; // the size of one encoded frame
+        std::uint64_t iterations;
+        double seconds;
+        double messagesPerSecond;
+        double bytesPerSecond;
+        double allocationsPerOp; // calls to operator new per message
+        double bytesAllocatedPerOp;
+    }; // END of struct Result
+
+    // operator new and delete are replaced for the whole program, so that the benchmarks can tell
+    // how many allocations a single encode or decode makes. these are the totals since the program started.
+    std::uint64_t getAllocationCount();
+    std::uint64_t getAllocatedBytes();
+
+    // runs operation in batches of growing size until at least minTime has passed, then takes the
+    // last batch's numbers. the first batch is a warm up and isn't counted.
+    class Runner final {
+    public:
+        using this_type = Runner;
+        using Operation = std::function<void ()>;
+
+        explicit Runner(std::chrono::milliseconds minTime, std::string filter);
+        void run(std::string operation, std::string messageType, std::size_t parameter, std::size_t frameBytes,
+                 Operation const &op);
+        std::vector<Result> const &getResults() const;
+        void writeJson(std::ostream &os) const;
+
+    private:
+        std::chrono::milliseconds minTime_;
+        std::string filter_; // only benchmarks whose name contains this run
+        std::vector<Result> results_;
+    }; // END of class Runner
+
+    // keeps the compiler from optimizing away a result nobody looks at
+    template <class Type>
+    void doNotOptimize(Type const &value) {
+#if defined(_MSC_VER)
+        static_cast<void>(*static_cast<volatile char const *>(static_cast<void const *>(&value)));
+#else
+        asm volatile("" : : "g"(&value) : "memory");
+#endif
+    }
+} // END of namespace bench
@@ -0,0 +1,137 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Benchmark.h"
+#include "Types.h"
+#include "functions.h"
+#include "Logger.h"
+
+// encodes and decodes every message type against in-memory buffers and prints what it measured as JSON.
+// usage: CodecBench [minimum time per benchmark in ms] [only the benchmarks whose name contains this]
+namespace {
+    using utils::Word;
+    using utils::HalfWord;
+    using utils::Byte;
+    using utils::MessageType;
+
+    static auto constexpr defaultMinTime = 250; // ms
+    static auto constexpr version = utils::protocolVersion;
+    static auto constexpr sourceIp = static_cast<Word>(0x7F000001U);
+    static auto constexpr targetIp = static_cast<Word>(0x7F000002U);
+    static auto constexpr sourcePort = static_cast<HalfWord>(31337U);
+    static auto constexpr targetPort = static_cast<HalfWord>(40000U);
+
+    // encodes into a buffer that's reused for every iteration, so what's measured is the codec and not the allocator;
+    // toByteArray adds exactly one buffer of frameBytes on top, which comes from malloc and isn't counted here.
+    template <class MessageT>
+    void benchMessage(bench::Runner &runner, MessageT const &message, std::size_t parameter) {
+        std::vector<char> buffer(message.encodedSize());
+        auto const end = message.serializeInto(buffer.data());
+        auto const check = func::decodeFrame(buffer.data(), buffer.size());
+        if (end != buffer.data() + buffer.size() || check.status != func::DecodeStatus::Complete
+            || check.bytesConsumed != buffer.size()) {
+            throw std::logic_error{ "the codec didn't round trip a " + std::string{ utils::getName(MessageT::messageType) } };
+        }
+
+        std::string const typeName{ utils::getName(MessageT::messageType) };
+        runner.run("encode", typeName, parameter, buffer.size(), [&message, &buffer] {
+            bench::doNotOptimize(message.serializeInto(buffer.data()));
+        });
+        runner.run("decode", typeName, parameter, buffer.size(), [&buffer] {
+            auto result = func::decodeFrame(buffer.data(), buffer.size());
+            bench::doNotOptimize(result);
+        });
+    }
+
+    template <class MessageT>
+    void benchHeaderOnly(bench::Runner &runner) {
+        benchMessage(runner, MessageT{ version, MessageT::messageType, 0U }, 0U);
+    }
+
+    std::vector<utils::UsernameRecord> makeRecords(std::size_t amount, std::size_t offset = 0U) {
+        LOG_SCOPE;
+        std::vector<utils::UsernameRecord> records{ };
+        records.reserve(amount);
+        for (auto i = offset; i < offset + amount; ++i) {
+            auto username = "user" + std::to_string(i);
+            records.emplace_back(sourceIp + static_cast<Word>(i), static_cast<HalfWord>(i % 65536U),
+                                 static_cast<Byte>(username.size()), std::move(username));
+        }
+        return records;
+    }
+
+    void benchLogin(bench::Runner &runner) {
+        LOG_SCOPE;
+        std::string username{ "benchmark_user" };
+        auto const length = static_cast<Word>(username.size());
+        benchMessage(runner, utils::ReqLoginMessage{ version, MessageType::reqLogin, length, std::move(username) }, length);
+    }
+
+    void benchClientList(bench::Runner &runner, std::size_t amtRecords) {
+        LOG_SCOPE;
+        utils::UpdateClientListMessage message{ version, MessageType::updateClientList, static_cast<Word>(amtRecords),
+                                                makeRecords(amtRecords) };
+        benchMessage(runner, message, amtRecords);
+    }
+
+    void benchClientListDelta(bench::Runner &runner, std::size_t amtRecords) { // half of them added, half removed
+        LOG_SCOPE;
+        auto const amtAdded = amtRecords / 2U;
+        utils::UpdateClientListDeltaMessage message{ version, MessageType::updateClientListDelta, static_cast<Word>(amtRecords),
+                                                     1U, 2U, makeRecords(amtAdded), makeRecords(amtRecords - amtAdded, amtAdded) };
+        benchMessage(runner, message, amtRecords);
+    }
+
+    template <class MessageT>
+    void benchSendMessage(bench::Runner &runner, std::size_t textLength) {
+        auto const length = static_cast<Word>(utils::sendMsgStructByteSize + textLength);
+        MessageT message{ version, MessageT::messageType, length, 1U, sourceIp, targetIp, sourcePort, targetPort,
+                          std::string(textLength, 'x') };
+        benchMessage(runner, message, textLength);
+    }
+
+    void benchNotDelivered(bench::Runner &runner) {
+        LOG_SCOPE;
+        utils::ErrorMsgNotDeliveredMessage message{ version, MessageType::errorMsgNotDelivered, utils::sendMsgStructByteSize,
+                                                    1U, sourceIp, targetIp, sourcePort, targetPort };
+        benchMessage(runner, message, 0U);
+    }
+} // END of anonymous namespace
+
+int main(int argc, char *argv[]) {
+    SET_LOG_LEVEL_ERROR; // keep LOG_SCOPE's tracing out of the numbers
+    LOG_SCOPE;
+    auto const minTime = std::chrono::milliseconds{ argc > 1 ? std::atoi(argv[1]) : defaultMinTime };
+    bench::Runner runner{ minTime, argc > 2 ? argv[2] : "" };
+
+    try {
+        benchHeaderOnly<utils::ReqFindServerMessage>(runner);
+        benchHeaderOnly<utils::ResFindServerMessage>(runner);
+        benchLogin(runner);
+        for (auto const amtRecords : { 10U, 1000U, 100000U }) {
+            benchClientList(runner, amtRecords);
+        }
+        for (auto const textLength : { 1U, 64U, 1024U }) {
+            benchSendMessage<utils::SendMsgGrpMessage>(runner, textLength);
+        }
+        for (auto const textLength : { 1U, 64U, 1024U, 16U * 1024U, 64U * 1024U, 1024U * 1024U }) {
+            benchSendMessage<utils::SendMsgUsrMessage>(runner, textLength);
+        }
+        benchHeaderOnly<utils::ReqHeartbeatMessage>(runner);
+        benchHeaderOnly<utils::ResHeartbeatMessage>(runner);
+        benchNotDelivered(runner);
+        for (auto const amtRecords : { 10U, 1000U }) {
+            benchClientListDelta(runner, amtRecords);
+        }
+        benchHeaderOnly<utils::ReqClientListMessage>(runner);
+    } catch (std::exception const &ex) {
+        std::cerr << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    runner.writeJson(std::cout);
+    return EXIT_SUCCESS;
+}
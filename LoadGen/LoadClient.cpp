@@ -0,0 +1,186 @@
+#include "LoadClient.h"
+#include <chrono>
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include "Types.h"
+#include "Logger.h"
+#include "HeartbeatMonitor.h"
+
+namespace {
+    std::uint64_t nowNs() { // the load generator sends and receives, so a monotonic clock of its own is all it needs
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static auto constexpr localhostIp = static_cast<utils::Word>(0x7F000001U); // the server sees every connection coming from here
+} // END of anonymous namespace
+
+namespace load {
+    LoadClient::LoadClient(int id, Stats &stats, QObject *parent)
+        : Base{ parent }, id_{ id }, stats_{ stats }, socket_{ this }, assembler_{ }, localPort_{ 0U }, messageId_{ 0U },
+          isReady_{ false }, isFailed_{ false } {
+        LOG_SCOPE;
+        connect(&socket_, SIGNAL(connected()), this, SLOT(connectedSlot()));
+        connect(&socket_, SIGNAL(readyRead()), this, SLOT(readyReadSlot()));
+        connect(&socket_, SIGNAL(disconnected()), this, SLOT(disconnectedSlot()));
+        connect(&socket_, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(errorSlot(QAbstractSocket::SocketError)));
+    }
+
+    void LoadClient::open(QString const &host, quint16 port) {
+        LOG_SCOPE;
+        socket_.connectToHost(host, port);
+    }
+
+    bool LoadClient::isReady() const {
+        LOG_SCOPE;
+        return isReady_;
+    }
+
+    quint16 LoadClient::getLocalPort() const {
+        LOG_SCOPE;
+        return localPort_;
+    }
+
+    void LoadClient::sendUsr(quint16 targetPort, std::size_t textSize) {
+        LOG_SCOPE;
+        auto text = makeText(textSize);
+        auto const length = static_cast<utils::Word>(utils::sendMsgStructByteSize + text.size());
+        utils::SendMsgUsrMessage const message{ utils::protocolVersion, utils::MessageType::sendMsgUsr, length, ++messageId_,
+                                                localhostIp, localhostIp, localPort_, targetPort, std::move(text) };
+        write(message.toByteArray());
+        ++stats_.sentUsr;
+    }
+
+    void LoadClient::sendGrp(std::size_t textSize) {
+        LOG_SCOPE;
+        auto text = makeText(textSize);
+        auto const length = static_cast<utils::Word>(utils::sendMsgStructByteSize + text.size());
+        utils::SendMsgGrpMessage const message{ utils::protocolVersion, utils::MessageType::sendMsgGrp, length, ++messageId_,
+                                                localhostIp, 0U, localPort_, 0U, std::move(text) };
+        write(message.toByteArray());
+        ++stats_.sentGrp;
+    }
+
+    void LoadClient::sendHeartbeat() {
+        LOG_SCOPE;
+        utils::ReqHeartbeatMessage const message{ utils::protocolVersion, utils::MessageType::reqHeartbeat, 0U };
+        write(message.toByteArray());
+        ++stats_.sentHeartbeats;
+    }
+
+    void LoadClient::close() {
+        LOG_SCOPE;
+        isReady_ = false;
+        socket_.abort();
+    }
+
+    void LoadClient::connectedSlot() {
+        LOG_SCOPE;
+        ++stats_.connected;
+        localPort_ = socket_.localPort();
+        auto username = "load" + std::to_string(id_);
+        auto const length = static_cast<utils::Word>(username.size());
+        write(utils::ReqLoginMessage{ utils::protocolVersion, utils::MessageType::reqLogin, length, std::move(username) }.toByteArray());
+    }
+
+    void LoadClient::readyReadSlot() {
+        LOG_SCOPE;
+        try {
+            stats_.bytesReceived += static_cast<std::uint64_t>(assembler_.readFrom(socket_));
+            while (auto frame = assembler_.takeFrame()) {
+                utils::visitFrame(std::move(*frame), [this](auto const &view) {
+                    handle(view);
+                });
+            }
+        } catch (std::logic_error const &ex) { // the assembler has thrown away what it had
+            ++stats_.malformed;
+            LOG_DEBUG << "Caught logic_error in LoadClient::readyReadSlot:\n" << ex.what() << '\n';
+        }
+    }
+
+    void LoadClient::disconnectedSlot() {
+        LOG_SCOPE;
+        if (isReady_ && !isFailed_) { // the server hung up on us in the middle of the run
+            isFailed_ = true;
+            ++stats_.failed;
+        }
+        isReady_ = false;
+    }
+
+    void LoadClient::errorSlot(QAbstractSocket::SocketError /*error*/) {
+        LOG_SCOPE;
+        if (localPort_ == 0U && !isFailed_) { // never got connected
+            isFailed_ = true;
+            ++stats_.failed;
+            LOG_WARNING << "LoadClient " << id_ << " couldn't connect: " << socket_.errorString().toStdString() << '\n';
+        }
+    }
+
+    void LoadClient::handle(utils::UpdateClientListDeltaView const &view) {
+        LOG_SCOPE;
+        if (view.isFullRoster() && !isReady_) { // what the server answers a login with
+            isReady_ = true;
+            ++stats_.loggedIn;
+            emit readySignal(id_, localPort_);
+        }
+    }
+
+    void LoadClient::handle(utils::SendMsgUsrView const &view) {
+        LOG_SCOPE;
+        ++stats_.receivedUsr;
+        recordLatency(view.getMessageText());
+    }
+
+    void LoadClient::handle(utils::SendMsgGrpView const &view) {
+        LOG_SCOPE;
+        ++stats_.receivedGrp;
+        recordLatency(view.getMessageText());
+    }
+
+    void LoadClient::handle(utils::ErrorMsgNotDeliveredView const &/*view*/) {
+        LOG_SCOPE;
+        ++stats_.notDelivered;
+    }
+
+    void LoadClient::handle(utils::ResHeartbeatView const &/*view*/) {
+        LOG_SCOPE;
+        ++stats_.receivedHeartbeats;
+    }
+
+    void LoadClient::handle(utils::ReqHeartbeatView const &/*view*/) {
+        LOG_SCOPE;
+        auto const &response = app::HeartbeatMonitor::responseFrame();
+        write(QByteArray::fromRawData(response.data(), static_cast<int>(response.size())));
+    }
+
+    void LoadClient::write(QByteArray const &bytes) {
+        LOG_SCOPE;
+        socket_.write(bytes);
+        stats_.bytesSent += static_cast<std::uint64_t>(bytes.size());
+    }
+
+    void LoadClient::recordLatency(std::string_view text) {
+        LOG_SCOPE;
+        auto const now = nowNs();
+        std::uint64_t sentAt = 0U;
+        auto const result = std::from_chars(text.data(), text.data() + text.size(), sentAt);
+        if (result.ec != std::errc{ } || sentAt > now) {
+            ++stats_.malformed;
+            return;
+        }
+        stats_.latency.record(now - sentAt);
+    }
+
+    std::string LoadClient::makeText(std::size_t textSize) const {
+        LOG_SCOPE;
+        auto text = std::to_string(nowNs()); // the timestamp has to stay, even if it makes the text longer than asked for
+        text.push_back(';');
+        if (text.size() < textSize) {
+            text.resize(textSize, 'x');
+        }
+        return text;
+    }
+} // END of namespace load
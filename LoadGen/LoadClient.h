@@ -0,0 +1,64 @@
+#pragma once
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QTcpSocket>
+#include <cstddef>
+#include <string_view>
+#include "FrameAssembler.h"
+#include "MessageViews.h"
+#include "LoadStats.h"
+
+namespace load {
+    // one simulated client: a raw protocol connection that logs in, sends what the worker tells it to
+    // and measures how long the chat messages addressed to it took to get through the server.
+    // it lives on its worker's thread and is driven by that thread's event loop.
+    class LoadClient final : public QObject {
+        Q_OBJECT
+    public:
+        using this_type = LoadClient;
+        using Base = QObject;
+
+        LoadClient(int id, Stats &stats, QObject *parent = nullptr);
+        void open(QString const &host, quint16 port);
+        bool isReady() const; // connected, and the server has confirmed the login with the full roster
+        quint16 getLocalPort() const; // the port the server knows this client by
+        void sendUsr(quint16 targetPort, std::size_t textSize);
+        void sendGrp(std::size_t textSize);
+        void sendHeartbeat();
+        void close();
+
+    signals:
+        void readySignal(int id, quint16 localPort);
+
+    private slots:
+        void connectedSlot();
+        void readyReadSlot();
+        void disconnectedSlot();
+        void errorSlot(QAbstractSocket::SocketError error);
+
+    private:
+        void handle(utils::UpdateClientListDeltaView const &view);
+        void handle(utils::SendMsgUsrView const &view);
+        void handle(utils::SendMsgGrpView const &view);
+        void handle(utils::ErrorMsgNotDeliveredView const &view);
+        void handle(utils::ResHeartbeatView const &view);
+        void handle(utils::ReqHeartbeatView const &view); // the server checking on an idle connection
+
+        template <class View>
+        void handle(View const &/*view*/) { } // the rest of the roster traffic isn't interesting here
+
+        void write(QByteArray const &bytes);
+        void recordLatency(std::string_view text); // the text starts with the time it was sent at
+        std::string makeText(std::size_t textSize) const;
+
+        int id_;
+        Stats &stats_;
+        QTcpSocket socket_;
+        func::FrameAssembler assembler_;
+        quint16 localPort_;
+        utils::Word messageId_;
+        bool isReady_;
+        bool isFailed_;
+    }; // END of class LoadClient
+} // END of namespace load
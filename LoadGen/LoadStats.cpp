@@ -0,0 +1,41 @@
+#include "LoadStats.h"
+#include <iomanip>
+#include "Logger.h"
+
+namespace load {
+    void writeReport(std::ostream &os, Config const &config, Stats const &stats, std::chrono::nanoseconds trafficTime) {
+        LOG_SCOPE;
+        auto const seconds = std::chrono::duration<double>{ trafficTime }.count();
+        auto const perSecond = [seconds](Stats::Counter const &counter) {
+            return seconds > 0.0 ? static_cast<double>(counter.load()) / seconds : 0.0;
+        };
+        auto const micros = [&stats](double quantile) {
+            return static_cast<double>(stats.latency.getQuantile(quantile)) / 1000.0;
+        };
+
+        auto const flags = os.flags();
+        os << std::fixed << std::setprecision(1)
+           << "{\n  \"config\": {\"host\": \"" << config.host << "\", \"port\": " << config.port
+           << ", \"connections\": " << config.connections << ", \"threads\": " << config.threads
+           << ", \"durationSeconds\": " << config.durationSeconds << ", \"usrRate\": " << config.usrRate
+           << ", \"grpRate\": " << config.grpRate << ", \"heartbeatRate\": " << config.heartbeatRate
+           << ", \"textSize\": " << config.textSize << "},\n"
+           << "  \"connections\": {\"connected\": " << stats.connected << ", \"loggedIn\": " << stats.loggedIn
+           << ", \"failed\": " << stats.failed << "},\n"
+           << "  \"seconds\": " << seconds << ",\n"
+           << "  \"sent\": {\"usr\": " << stats.sentUsr << ", \"grp\": " << stats.sentGrp
+           << ", \"heartbeats\": " << stats.sentHeartbeats << ", \"bytes\": " << stats.bytesSent << "},\n"
+           << "  \"received\": {\"usr\": " << stats.receivedUsr << ", \"grp\": " << stats.receivedGrp
+           << ", \"heartbeats\": " << stats.receivedHeartbeats << ", \"notDelivered\": " << stats.notDelivered
+           << ", \"malformed\": " << stats.malformed << ", \"bytes\": " << stats.bytesReceived << "},\n"
+           << "  \"throughput\": {\"sentUsrPerSecond\": " << perSecond(stats.sentUsr)
+           << ", \"sentGrpPerSecond\": " << perSecond(stats.sentGrp)
+           << ", \"receivedPerSecond\": " << perSecond(stats.receivedUsr) + perSecond(stats.receivedGrp)
+           << ", \"bytesSentPerSecond\": " << perSecond(stats.bytesSent)
+           << ", \"bytesReceivedPerSecond\": " << perSecond(stats.bytesReceived) << "},\n"
+           << "  \"latencyMicros\": {\"samples\": " << stats.latency.getCount() << ", \"p50\": " << micros(0.5)
+           << ", \"p99\": " << micros(0.99) << ", \"p999\": " << micros(0.999)
+           << ", \"max\": " << static_cast<double>(stats.latency.getMax()) / 1000.0 << "}\n}\n";
+        os.flags(flags);
+    }
+} // END of namespace load
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <QtGlobal>
+#include "Metrics.h"
+
+namespace load {
+    struct Config final {
+        using this_type = Config;
+        std::string host;
+        quint16 port;
+        int connections;
+        int threads;
+        int connectRate; // new connections per second
+        int durationSeconds; // how long the traffic runs once everybody is logged in
+        double usrRate; // SendMsgUsr per second, over all connections
+        double grpRate; // SendMsgGrp per second; every one of them is fanned out to every connection
+        double heartbeatRate; // ReqHeartbeat per second
+        std::size_t textSize; // the message text, the timestamp included
+    }; // END of struct Config
+
+    // what all the connections saw, summed up. shared by the worker threads, so everything is atomic.
+    struct Stats final {
+        using this_type = Stats;
+        using Counter = std::atomic<std::uint64_t>;
+
+        Counter connected{ 0U };
+        Counter loggedIn{ 0U };
+        Counter failed{ 0U }; // couldn't connect or were disconnected by the server
+        Counter sentUsr{ 0U };
+        Counter sentGrp{ 0U };
+        Counter sentHeartbeats{ 0U };
+        Counter receivedUsr{ 0U };
+        Counter receivedGrp{ 0U };
+        Counter receivedHeartbeats{ 0U };
+        Counter notDelivered{ 0U };
+        Counter malformed{ 0U }; // frames the load generator couldn't make sense of
+        Counter bytesSent{ 0U };
+        Counter bytesReceived{ 0U };
+        metrics::Histogram latency; // ns from putting a chat message on the wire until it came back out of the server
+    }; // END of struct Stats
+
+    void writeReport(std::ostream &os, Config const &config, Stats const &stats, std::chrono::nanoseconds trafficTime);
+} // END of namespace load
@@ -0,0 +1,136 @@
+#include "LoadWorker.h"
+#include <algorithm>
+#include <cmath>
+#include "Logger.h"
+
+namespace load {
+    LoadWorker::LoadWorker(Config const &config, Stats &stats, PortTable &ports, int firstId, int lastId)
+        : Base{ nullptr }, config_{ config }, stats_{ stats }, ports_{ ports }, firstId_{ firstId }, lastId_{ lastId },
+          nextId_{ firstId }, clients_{ }, connectTimer_{ nullptr }, trafficTimer_{ nullptr }, lastTick_{ },
+          usrBudget_{ 0.0 }, grpBudget_{ 0.0 }, heartbeatBudget_{ 0.0 },
+          share_{ config.connections > 0 ? static_cast<double>(lastId - firstId) / config.connections : 0.0 },
+          random_{ static_cast<std::mt19937::result_type>(firstId) } {
+        LOG_SCOPE;
+    }
+
+    LoadWorker::~LoadWorker() {
+        LOG_SCOPE;
+    }
+
+    void LoadWorker::startSlot() {
+        LOG_SCOPE;
+        clients_.reserve(static_cast<std::size_t>(lastId_ - firstId_));
+        connectTimer_ = std::make_unique<QTimer>();
+        trafficTimer_ = std::make_unique<QTimer>();
+        connect(connectTimer_.get(), SIGNAL(timeout()), this, SLOT(connectTickSlot()));
+        connect(trafficTimer_.get(), SIGNAL(timeout()), this, SLOT(trafficTickSlot()));
+        connectTimer_->start(tickInterval);
+        connectTickSlot();
+    }
+
+    void LoadWorker::connectTickSlot() {
+        LOG_SCOPE;
+        static auto constexpr ticksPerSecond = 1000.0 / tickInterval;
+        auto const perTick = std::max(1, static_cast<int>(std::ceil(config_.connectRate * share_ / ticksPerSecond)));
+        for (auto i = 0; i < perTick && nextId_ < lastId_; ++i, ++nextId_) {
+            clients_.push_back(std::make_unique<LoadClient>(nextId_, stats_));
+            connect(clients_.back().get(), SIGNAL(readySignal(int, quint16)), this, SLOT(clientReadySlot(int, quint16)));
+            clients_.back()->open(QString::fromStdString(config_.host), config_.port);
+        }
+        if (nextId_ == lastId_) {
+            connectTimer_->stop();
+        }
+    }
+
+    void LoadWorker::clientReadySlot(int id, quint16 localPort) {
+        LOG_SCOPE;
+        ports_[static_cast<std::size_t>(id)].store(localPort, std::memory_order_relaxed);
+    }
+
+    void LoadWorker::startTrafficSlot() {
+        LOG_SCOPE;
+        lastTick_ = Clock::now();
+        trafficTimer_->start(tickInterval);
+    }
+
+    void LoadWorker::stopTrafficSlot() {
+        LOG_SCOPE;
+        trafficTimer_->stop();
+    }
+
+    void LoadWorker::closeSlot() {
+        LOG_SCOPE;
+        connectTimer_.reset();
+        trafficTimer_.reset();
+        for (auto &client : clients_) {
+            client->close();
+        }
+        clients_.clear();
+    }
+
+    void LoadWorker::trafficTickSlot() {
+        LOG_SCOPE;
+        // the budgets grow with the time that has actually passed, so a late tick doesn't lower the rate
+        auto const now = Clock::now();
+        auto const elapsed = std::chrono::duration<double>{ now - lastTick_ }.count();
+        lastTick_ = now;
+        usrBudget_ += config_.usrRate * share_ * elapsed;
+        grpBudget_ += config_.grpRate * share_ * elapsed;
+        heartbeatBudget_ += config_.heartbeatRate * share_ * elapsed;
+
+        for (; usrBudget_ >= 1.0; usrBudget_ -= 1.0) {
+            auto const sender = pickSender();
+            if (sender == nullptr) {
+                break;
+            }
+            auto const target = pickTarget(sender->getLocalPort());
+            if (target == 0U) {
+                break;
+            }
+            sender->sendUsr(target, config_.textSize);
+        }
+        for (; grpBudget_ >= 1.0; grpBudget_ -= 1.0) {
+            auto const sender = pickSender();
+            if (sender == nullptr) {
+                break;
+            }
+            sender->sendGrp(config_.textSize);
+        }
+        for (; heartbeatBudget_ >= 1.0; heartbeatBudget_ -= 1.0) {
+            auto const sender = pickSender();
+            if (sender == nullptr) {
+                break;
+            }
+            sender->sendHeartbeat();
+        }
+    }
+
+    LoadClient *LoadWorker::pickSender() {
+        LOG_SCOPE;
+        static auto constexpr maxAttempts = 8;
+        if (clients_.empty()) {
+            return nullptr;
+        }
+        std::uniform_int_distribution<std::size_t> distribution{ 0U, clients_.size() - 1U };
+        for (auto i = 0; i < maxAttempts; ++i) {
+            auto const client = clients_[distribution(random_)].get();
+            if (client->isReady()) {
+                return client;
+            }
+        }
+        return nullptr;
+    }
+
+    quint16 LoadWorker::pickTarget(quint16 except) {
+        LOG_SCOPE;
+        static auto constexpr maxAttempts = 8;
+        std::uniform_int_distribution<std::size_t> distribution{ 0U, ports_.size() - 1U };
+        for (auto i = 0; i < maxAttempts; ++i) {
+            auto const port = ports_[distribution(random_)].load(std::memory_order_relaxed);
+            if (port != 0U && (port != except || ports_.size() == 1U)) {
+                return port;
+            }
+        }
+        return 0U;
+    }
+} // END of namespace load
@@ -0,0 +1,63 @@
+#pragma once
+#include <QObject>
+#include <QTimer>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+#include "LoadClient.h"
+#include "LoadStats.h"
+
+namespace load {
+    // the ports every client is known to the server by, indexed by client id; 0 until the client is logged in.
+    // any worker picks its SendMsgUsr targets from here, so the traffic crosses the server's threads.
+    using PortTable = std::vector<std::atomic<quint16>>;
+
+    // drives a share of the clients from one thread: opens them at the configured rate and, once the traffic
+    // is started, sends its share of the configured rates every tick.
+    class LoadWorker final : public QObject {
+        Q_OBJECT
+    public:
+        using this_type = LoadWorker;
+        using Base = QObject;
+        using Clock = std::chrono::steady_clock;
+
+        static auto constexpr tickInterval = 10; // ms
+
+        // the clients firstId up to, but not including, lastId belong to this worker
+        LoadWorker(Config const &config, Stats &stats, PortTable &ports, int firstId, int lastId);
+        ~LoadWorker();
+
+    public slots:
+        void startSlot(); // starts opening the connections
+        void startTrafficSlot();
+        void stopTrafficSlot();
+        void closeSlot(); // closes every connection; has to run on the worker's thread
+
+    private slots:
+        void connectTickSlot();
+        void trafficTickSlot();
+        void clientReadySlot(int id, quint16 localPort);
+
+    private:
+        LoadClient *pickSender();
+        quint16 pickTarget(quint16 except);
+
+        Config const &config_;
+        Stats &stats_;
+        PortTable &ports_;
+        int firstId_;
+        int lastId_;
+        int nextId_; // the next client to be opened
+        std::vector<std::unique_ptr<LoadClient>> clients_;
+        std::unique_ptr<QTimer> connectTimer_; // created on the worker's thread
+        std::unique_ptr<QTimer> trafficTimer_;
+        Clock::time_point lastTick_;
+        double usrBudget_; // the messages that are due but haven't been sent yet, fractions included
+        double grpBudget_;
+        double heartbeatBudget_;
+        double share_; // this worker's part of the rates
+        std::mt19937 random_;
+    }; // END of class LoadWorker
+} // END of namespace load
@@ -0,0 +1,144 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "IoThreadPool.h"
+#include "LoadWorker.h"
+#include "LoadStats.h"
+#include "Logger.h"
+
+// opens thousands of protocol connections to a server, logs them all in, runs a mix of SendMsgUsr, SendMsgGrp
+// and heartbeat traffic at the given rates and prints the throughput and the end to end latencies as JSON.
+// see LoadGen --help for the options.
+namespace {
+    static auto constexpr pollInterval = 100; // ms
+    static auto constexpr loginTimeout = std::chrono::seconds{ 60 };
+    static auto constexpr drainTime = 1000; // ms to wait for the messages still in flight once the traffic stops
+
+    // holds everything the phases of a run share. runs on the main thread; the workers are only ever
+    // talked to through queued calls.
+    class Run final {
+    public:
+        using this_type = Run;
+        using Clock = std::chrono::steady_clock;
+
+        explicit Run(load::Config config)
+            : config_{ std::move(config) }, stats_{ }, ports_(static_cast<std::size_t>(config_.connections)),
+              ioThreads_{ config_.threads }, workers_{ }, pollTimer_{ }, loginStart_{ }, trafficStart_{ }, trafficTime_{ } {
+            LOG_SCOPE;
+            for (auto &port : ports_) {
+                port.store(0U);
+            }
+            auto const threads = ioThreads_.size();
+            for (auto i = 0; i < threads; ++i) {
+                auto const firstId = static_cast<int>(static_cast<long long>(config_.connections) * i / threads);
+                auto const lastId = static_cast<int>(static_cast<long long>(config_.connections) * (i + 1) / threads);
+                workers_.push_back(std::make_unique<load::LoadWorker>(config_, stats_, ports_, firstId, lastId));
+                workers_.back()->moveToThread(ioThreads_.at(i));
+            }
+        }
+
+        void start() {
+            LOG_SCOPE;
+            loginStart_ = Clock::now();
+            invokeAll("startSlot", Qt::QueuedConnection);
+            QObject::connect(&pollTimer_, &QTimer::timeout, [this] {
+                pollLogins();
+            });
+            pollTimer_.start(pollInterval);
+        }
+
+    private:
+        void pollLogins() { // starts the traffic once everybody has either logged in or failed
+            LOG_SCOPE;
+            auto const settled = stats_.loggedIn + stats_.failed;
+            auto const isTimedOut = Clock::now() - loginStart_ > loginTimeout;
+            if (settled < static_cast<std::uint64_t>(config_.connections) && !isTimedOut) {
+                return;
+            }
+            pollTimer_.stop();
+            if (isTimedOut) {
+                LOG_WARNING << "LoadGen: only " << stats_.loggedIn << " of " << config_.connections << " clients logged in\n";
+            }
+            trafficStart_ = Clock::now();
+            invokeAll("startTrafficSlot", Qt::QueuedConnection);
+            QTimer::singleShot(config_.durationSeconds * 1000, [this] {
+                stopTraffic();
+            });
+        }
+
+        void stopTraffic() {
+            LOG_SCOPE;
+            invokeAll("stopTrafficSlot", Qt::BlockingQueuedConnection);
+            trafficTime_ = Clock::now() - trafficStart_;
+            QTimer::singleShot(drainTime, [this] {
+                finish();
+            });
+        }
+
+        void finish() {
+            LOG_SCOPE;
+            invokeAll("closeSlot", Qt::BlockingQueuedConnection);
+            ioThreads_.stop();
+            load::writeReport(std::cout, config_, stats_, trafficTime_);
+            QCoreApplication::quit();
+        }
+
+        void invokeAll(char const *slot, Qt::ConnectionType type) {
+            LOG_SCOPE;
+            for (auto &worker : workers_) {
+                QMetaObject::invokeMethod(worker.get(), slot, type);
+            }
+        }
+
+        load::Config config_;
+        load::Stats stats_;
+        load::PortTable ports_;
+        app::IoThreadPool ioThreads_;
+        std::vector<std::unique_ptr<load::LoadWorker>> workers_; // destroyed before the threads, which are stopped by then
+        QTimer pollTimer_;
+        Clock::time_point loginStart_;
+        Clock::time_point trafficStart_;
+        Clock::duration trafficTime_;
+    }; // END of class Run
+
+    load::Config parseArguments(QCoreApplication const &application) {
+        LOG_SCOPE;
+        QCommandLineParser parser{ };
+        parser.setApplicationDescription("Simulates many RNP3 clients against a running server.");
+        parser.addHelpOption();
+        QCommandLineOption const host{ "host", "The server to connect to.", "host", "127.0.0.1" };
+        QCommandLineOption const port{ "port", "The server's port.", "port", "31337" };
+        QCommandLineOption const connections{ "connections", "The amount of clients.", "n", "1000" };
+        QCommandLineOption const threads{ "threads", "The threads driving the clients.", "n", QString::number(QThread::idealThreadCount()) };
+        QCommandLineOption const connectRate{ "connect-rate", "New connections per second.", "n", "1000" };
+        QCommandLineOption const duration{ "duration", "Seconds of traffic once all clients are logged in.", "s", "10" };
+        QCommandLineOption const usrRate{ "usr-rate", "SendMsgUsr per second, over all clients.", "n", "1000" };
+        QCommandLineOption const grpRate{ "grp-rate", "SendMsgGrp per second; each one goes to every client.", "n", "1" };
+        QCommandLineOption const heartbeatRate{ "heartbeat-rate", "ReqHeartbeat per second.", "n", "100" };
+        QCommandLineOption const textSize{ "text-size", "Bytes of message text, at least the timestamp.", "bytes", "64" };
+        parser.addOptions({ host, port, connections, threads, connectRate, duration, usrRate, grpRate, heartbeatRate, textSize });
+        parser.process(application);
+
+        return load::Config{ parser.value(host).toStdString(), static_cast<quint16>(parser.value(port).toUInt()),
+                             std::max(1, parser.value(connections).toInt()), std::max(1, parser.value(threads).toInt()),
+                             std::max(1, parser.value(connectRate).toInt()), std::max(0, parser.value(duration).toInt()),
+                             parser.value(usrRate).toDouble(), parser.value(grpRate).toDouble(),
+                             parser.value(heartbeatRate).toDouble(), parser.value(textSize).toULongLong() };
+    }
+} // END of anonymous namespace
+
+int main(int argc, char *argv[]) {
+    SET_LOG_LEVEL_WARNING;
+    LOG_SCOPE;
+    QCoreApplication application{ argc, argv };
+    QCoreApplication::setApplicationName("LoadGen");
+    Run run{ parseArguments(application) };
+    run.start();
+    return application.exec();
+}
@@ -0,0 +1,72 @@
+#include "BufferPool.h"
+#include <algorithm>
+#include <utility>
+#include "Logger.h"
+
+namespace utils {
+    double BufferPool::Stats::hitRate() const {
+        LOG_SCOPE;
+        auto const acquires = hits + misses;
+        return acquires == 0U ? 0.0 : static_cast<double>(hits) / static_cast<double>(acquires);
+    }
+
+    BufferPool::BufferPool(int bufferCapacity, std::size_t maxPooled)
+        : buffers_{ }, bufferCapacity_{ bufferCapacity }, maxPooled_{ maxPooled }, stats_{ 0U, 0U, 0U, 0U } {
+        LOG_SCOPE;
+        buffers_.reserve(maxPooled_);
+    }
+
+    BufferPool &BufferPool::forCurrentThread() {
+        LOG_SCOPE;
+        static thread_local this_type pool{ };
+        return pool;
+    }
+
+    QByteArray BufferPool::acquire(int minCapacity) {
+        LOG_SCOPE;
+        auto const it = std::find_if(std::begin(buffers_), std::end(buffers_), [minCapacity](QByteArray const &buffer) {
+            return buffer.isDetached() && buffer.capacity() >= minCapacity;
+        });
+
+        if (it != std::end(buffers_)) {
+            ++stats_.hits;
+            auto buffer = std::move(*it);
+            buffers_.erase(it);
+            buffer.resize(0); // keeps the capacity, since the buffer was reserve()d
+            return buffer;
+        }
+
+        ++stats_.misses;
+        ++stats_.live;
+        stats_.highWater = std::max(stats_.highWater, stats_.live);
+        QByteArray buffer{ };
+        buffer.reserve(std::max(bufferCapacity_, minCapacity));
+        return buffer;
+    }
+
+    void BufferPool::release(QByteArray buffer) {
+        LOG_SCOPE;
+        if (buffer.capacity() == 0) {
+            return; // was never acquired from a pool
+        }
+
+        if (buffers_.size() < maxPooled_) {
+            buffers_.push_back(std::move(buffer));
+            return;
+        }
+
+        // full; drop a buffer that's still shared rather than one we could reuse right away
+        auto const it = std::find_if(std::begin(buffers_), std::end(buffers_), [](QByteArray const &pooled) {
+            return !pooled.isDetached();
+        });
+        if (it != std::end(buffers_) && buffer.isDetached()) {
+            *it = std::move(buffer);
+        }
+        --stats_.live;
+    }
+
+    BufferPool::Stats BufferPool::getStats() const {
+        LOG_SCOPE;
+        return stats_;
+    }
+} // END of namespace utils
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <QByteArray>
+
+namespace utils {
+    // recycles receive buffers so that reading from a socket doesn't cost an allocation per read.
+    // a buffer that is handed back is only reused once every Frame pointing into it is gone,
+    // which is exactly what the reference count of the QByteArray tells us.
+    // a pool is not thread safe; every thread uses its own through forCurrentThread().
+    class BufferPool final {
+    public:
+        using this_type = BufferPool;
+        using container_type = std::vector<QByteArray>;
+
+        struct Stats final {
+            using this_type = Stats;
+            std::size_t hits; // acquires served from the pool
+            std::size_t misses; // acquires that had to allocate
+            std::size_t live; // buffers the pool is accounting for: pooled plus handed out
+            std::size_t highWater; // the most buffers that were ever live at the same time
+            double hitRate() const;
+        }; // END of struct Stats
+
+        static int constexpr defaultBufferCapacity = 64 * 1024;
+        static std::size_t constexpr defaultMaxPooled = 16U;
+
+        explicit BufferPool(int bufferCapacity = defaultBufferCapacity, std::size_t maxPooled = defaultMaxPooled);
+        BufferPool(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+        static this_type &forCurrentThread();
+        QByteArray acquire(int minCapacity); // an empty buffer with room for at least minCapacity bytes
+        void release(QByteArray buffer); // frames may still point into it
+        Stats getStats() const;
+
+    private:
+        container_type buffers_;
+        int bufferCapacity_;
+        std::size_t maxPooled_;
+        Stats stats_;
+    }; // END of class BufferPool
+} // END of namespace utils
@@ -1,86 +1,439 @@
 #include "ClientManager.h"
-#include <functional>
-#include <memory>
-#include <QTcpSocket>
-#include "functions.h"
-#include "Logger.h"
 #include <utility>
+#include <thread>
+#include <algorithm>
+#include "Logger.h"
+#include "Metrics.h"
+#ifdef Q_OS_UNIX
+#   include <sys/socket.h>
+#   include <sys/uio.h>
+#   include <climits>
+#   include <cerrno>
+#   include <cstddef>
+#   include <type_traits>
+#endif
+
+namespace {
+    metrics::Counter &socketWrites() { // compared with framesSent this shows how well the writes coalesce
+        LOG_SCOPE;
+        static auto &counter = metrics::Registry::getRegistry().counter("rnp3_socket_writes_total",
+                                                                        "Write calls handed to client sockets.");
+        return counter;
+    }
+
+    metrics::Counter &framesSent() {
+        LOG_SCOPE;
+        static auto &counter = metrics::Registry::getRegistry().counter("rnp3_frames_sent_total", "Frames written to client sockets.");
+        return counter;
+    }
+
+    metrics::Gauge &bytesQueued() { // the server wide account the serverLimit is checked against
+        LOG_SCOPE;
+        static auto &gauge = metrics::Registry::getRegistry().gauge("rnp3_send_queued_bytes",
+                                                                    "Bytes written to client connections but not handed to the kernel yet.");
+        return gauge;
+    }
+
+    metrics::Counter &framesDropped() {
+        LOG_SCOPE;
+        static auto &counter = metrics::Registry::getRegistry().counter("rnp3_send_dropped_frames_total",
+                                                                        "Frames thrown away because the client wasn't reading fast enough.");
+        return counter;
+    }
+
+    metrics::Counter &slowConsumerDisconnects() {
+        LOG_SCOPE;
+        static auto &counter = metrics::Registry::getRegistry().counter("rnp3_slow_consumer_disconnects_total",
+                                                                        "Clients disconnected because they weren't reading fast enough.");
+        return counter;
+    }
+
+    metrics::Counter &heartbeatsSent() {
+        LOG_SCOPE;
+        static auto &counter = metrics::Registry::getRegistry().counter("rnp3_heartbeats_sent_total",
+                                                                        "ReqHeartbeats sent to clients that had been silent.");
+        return counter;
+    }
+
+    metrics::Counter &idleDisconnects() {
+        LOG_SCOPE;
+        static auto &counter = metrics::Registry::getRegistry().counter("rnp3_idle_disconnects_total",
+                                                                        "Clients disconnected because they didn't answer the heartbeats.");
+        return counter;
+    }
+
+    bool isChat(utils::Frame const &frame) {
+        LOG_SCOPE;
+        auto const type = frame.getType();
+        return type == utils::MessageType::sendMsgGrp || type == utils::MessageType::sendMsgUsr;
+    }
+
+#ifdef Q_OS_UNIX
+    // writeGathered hands the slices of a GatherList to the kernel as they are
+    static_assert(std::is_standard_layout<utils::IoSlice>::value, "IoSlice has to be standard layout to stand in for iovec");
+    static_assert(sizeof(utils::IoSlice) == sizeof(iovec), "IoSlice doesn't have the size of iovec");
+    static_assert(offsetof(utils::IoSlice, data) == offsetof(iovec, iov_base), "IoSlice::data isn't where iovec::iov_base is");
+    static_assert(offsetof(utils::IoSlice, size) == offsetof(iovec, iov_len), "IoSlice::size isn't where iovec::iov_len is");
+    static_assert(sizeof(utils::IoSlice::size) == sizeof(iovec::iov_len), "IoSlice::size doesn't have the size of iovec::iov_len");
+
+#   ifdef MSG_NOSIGNAL
+    auto constexpr sendFlags = MSG_NOSIGNAL; // a peer that has gone away makes the send fail with EPIPE instead of raising SIGPIPE
+#   else
+    auto constexpr sendFlags = 0; // the socket has SO_NOSIGPIPE set instead, see initializeSlot
+#   endif
+#endif
+} // END of anonymous namespace
 
 namespace app {
-    void ClientManager::clientManagerThreadFunction(Mutex &initMutex, std::condition_variable &initCv,
-                                     std::atomic_bool &isInitlialized,
-                                     ClientInfo &ci, QDataStream &dataStream,
-                                     qintptr socketDescriptor) {
-        
+    void ClientManager::Deleter::operator()(ClientManager *clientManager) const {
+        LOG_SCOPE;
+        if (clientManager->thread()->isRunning()) {
+            clientManager->deleteLater();
+        } else { // shutting down: nothing runs on the thread anymore, and a deferred delete would never happen
+            delete clientManager;
+        }
+    }
+
+    ClientManager::ClientManager(QThread *ioThread, SendLimits sendLimits, HeartbeatMonitor *heartbeats)
+        : Base{ nullptr }, socket_{ nullptr }, assembler_{ }, clientInfo_{ }, clientInfoMutex_{ },
+          inbox_{ inboxCapacity }, isWakeupPending_{ false }, activeDrains_{ 0 },
+          outbox_{ }, isFlushPending_{ false }, outgoing_{ }, sendLimits_{ sendLimits }, bytesQueued_{ 0U },
+          isCongested_{ false }, isDisconnecting_{ false }, isReadingPaused_{ false }, bytesReceived_{ 0U }, bytesSent_{ 0U }, framesReceived_{ 0U },
+          heartbeats_{ heartbeats }, heartbeatTimer_{ }, missedHeartbeats_{ 0 }, isHeardFrom_{ false } {
+        LOG_SCOPE;
+        moveToThread(ioThread);
+    }
+
+    ClientManager::~ClientManager() {
+        LOG_SCOPE;
+        // the dispatcher may be draining the inbox on a worker thread right now, or have a drain scheduled.
+        // nothing new can be scheduled from here on, as that only ever happens on this thread.
+        while (isWakeupPending_ || activeDrains_ > 0) {
+            std::this_thread::yield();
+        }
+        if (heartbeats_ != nullptr) { // on the I/O thread, or on any thread once the I/O threads are gone
+            heartbeats_->cancel(heartbeatTimer_);
+        }
+        bytesQueued().add(-static_cast<std::int64_t>(bytesQueued_.load())); // never going to be sent
+    }
+
+    void ClientManager::start(qintptr socketDescriptor) {
+        LOG_SCOPE;
+        // the socket may have a frame waiting already, so it's only read from once there is someone to tell about it
+        QMetaObject::invokeMethod(this, "initializeSlot", Qt::QueuedConnection, Q_ARG(qintptr, socketDescriptor));
+    }
+
+    ClientManager::ClientInfo ClientManager::getClientInfo() const {
+        LOG_SCOPE;
+        Lock lock{ clientInfoMutex_ };
+        return clientInfo_;
+    }
+
+    std::size_t ClientManager::getInboxDepth() const {
+        LOG_SCOPE;
+        return inbox_.size();
+    }
+
+    ClientManager::Stats ClientManager::getStats() const {
+        LOG_SCOPE;
+        return Stats{ bytesReceived_.load(std::memory_order_relaxed), bytesSent_.load(std::memory_order_relaxed),
+                      framesReceived_.load(std::memory_order_relaxed), bytesQueued_.load(std::memory_order_relaxed) };
+    }
+
+    void ClientManager::writeToSocket(QByteArray data) {
+        LOG_SCOPE;
+        auto const size = data.size();
+        enqueue(utils::Frame{ std::move(data), 0, size });
+    }
+
+    void ClientManager::writeToSocket(utils::Frame const &frame) {
+        LOG_SCOPE;
+        enqueue(frame);
+    }
+
+    void ClientManager::enqueue(utils::Frame frame) {
+        LOG_SCOPE;
+        if (isDisconnecting_) {
+            framesDropped().add();
+            return;
+        }
+
+        auto const size = frame.size();
+        if (!isCongested_ && isSlowConsumer()) {
+            isCongested_ = true;
+            if (sendLimits_.policy == SlowConsumerPolicy::Disconnect && !isDisconnecting_.exchange(true)) {
+                LOG_WARNING << "ClientManager: disconnecting a client with " << bytesQueued_.load() << " bytes it hasn't read\n";
+                slowConsumerDisconnects().add();
+                framesDropped().add();
+                QMetaObject::invokeMethod(this, "abortSlot", Qt::QueuedConnection);
+                return;
+            }
+        }
+        if (isCongested_ && isChat(frame)) {
+            framesDropped().add();
+            return;
+        }
+
+        bytesQueued_ += size;
+        bytesQueued().add(static_cast<std::int64_t>(size));
+        outbox_.push(std::move(frame));
+        // even on the I/O thread itself the write is left to flushSlot, so whatever else this event loop iteration
+        // writes to the connection (a FanOut batch, a shard's deliveries) goes out in the same syscall
+        if (!isFlushPending_.exchange(true)) {
+            QMetaObject::invokeMethod(this, "flushSlot", Qt::QueuedConnection);
+        }
+    }
+
+    bool ClientManager::isSlowConsumer() const {
         LOG_SCOPE;
-        std::unique_ptr<QTcpSocket> pSocket{ nullptr };
+        // judged by the backlog alone: a single big frame, such as the roster for a login, doesn't make an idle client slow
+        auto const queued = bytesQueued_.load(std::memory_order_relaxed);
+        if (queued > sendLimits_.highWatermark) {
+            return true;
+        }
+        // when memory is tight over all, everyone with a backlog worth mentioning has to give up theirs
+        return queued > sendLimits_.lowWatermark
+               && static_cast<std::size_t>(std::max<std::int64_t>(bytesQueued().get(), 0)) > sendLimits_.serverLimit;
+    }
+
+    void ClientManager::releaseQueued(std::size_t bytes) {
+        LOG_SCOPE;
+        auto const queued = bytesQueued_ -= bytes;
+        bytesQueued().add(-static_cast<std::int64_t>(bytes));
+        if (queued <= sendLimits_.lowWatermark && !isDisconnecting_) {
+            isCongested_ = false;
+        }
+    }
+
+    void ClientManager::initializeSlot(qintptr socketDescriptor) {
+        LOG_SCOPE;
+        socket_ = std::make_unique<QTcpSocket>();
+        if (!socket_->setSocketDescriptor(socketDescriptor)) {
+            LOG_ERROR << "ClientManager::initializeSlot: couldn't adopt socket descriptor " << socketDescriptor << '\n';
+            emit disconnectedSignal();
+            return;
+        }
+
         {
-            Lock lock{ initMutex };
-            pSocket = std::make_unique<QTcpSocket>();
-            pSocket->setSocketDescriptor(socketDescriptor);
-            ci.clientAddress = pSocket->peerAddress();
-            ci.clientPort = pSocket->peerPort();
-            ci.localAddress = pSocket->localAddress();
-            ci.localPort = pSocket->localPort();
-            dataStream.setDevice(pSocket.get());
-            isInitlialized = true;
-            initCv.notify_all();
-        }
-        
-        forever {
-            // read messages from socket
-            try {
-                if (!isThreadRunning_) {
-                    return;
-                }
-                pSocket->waitForReadyRead(3000);
-                if (pSocket->bytesAvailable() == 0) {
+            Lock lock{ clientInfoMutex_ };
+            clientInfo_.clientAddress = socket_->peerAddress();
+            clientInfo_.clientPort = socket_->peerPort();
+            clientInfo_.localAddress = socket_->localAddress();
+            clientInfo_.localPort = socket_->localPort();
+        }
+
+        // unbounded, Qt would keep reading from the kernel while we're paused, and the client would never notice
+        socket_->setReadBufferSize(readBufferSize);
+#if defined(Q_OS_UNIX) && !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+        auto const one = 1;
+        ::setsockopt(static_cast<int>(socketDescriptor), SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one)); // for writeGathered
+#endif
+        connect(socket_.get(), SIGNAL(readyRead()), this, SLOT(readyReadSlot()));
+        connect(socket_.get(), SIGNAL(disconnected()), this, SLOT(disconnectedSlot()));
+        connect(socket_.get(), SIGNAL(bytesWritten(qint64)), this, SLOT(bytesWrittenSlot(qint64)));
+        scheduleHeartbeat();
+        readyReadSlot(); // the client may have sent something before the socket was set up
+    }
+
+    void ClientManager::readyReadSlot() {
+        LOG_SCOPE;
+        if (isReadingPaused_) {
+            // once Qt's read buffer is full, it stops reading, the kernel's receive buffer fills up
+            // and TCP's flow control makes the client wait until the dispatcher has caught up
+            return;
+        }
+
+        try {
+            auto const bytesRead = static_cast<std::uint64_t>(assembler_.readFrom(*socket_));
+            bytesReceived_.store(bytesReceived_.load(std::memory_order_relaxed) + bytesRead, std::memory_order_relaxed);
+            metrics::bytesReceived().add(bytesRead);
+            fillInbox();
+        } catch (std::logic_error const &ex) { // a malformed header; the assembler has thrown away what it had
+            metrics::decodeFailures().add();
+            LOG_DEBUG << "Caught logic_error in ClientManager::readyReadSlot:\n" << ex.what() << '\n';
+        } catch (...) {
+            LOG_ERROR << "Unknown exception caught in ClientManager::readyReadSlot\n";
+        }
+    }
+
+    void ClientManager::resumeReadingSlot() {
+        LOG_SCOPE;
+        try {
+            fillInbox(); // the frames that didn't fit last time
+        } catch (std::logic_error const &ex) {
+            metrics::decodeFailures().add();
+            LOG_DEBUG << "Caught logic_error in ClientManager::resumeReadingSlot:\n" << ex.what() << '\n';
+        }
+        readyReadSlot();
+    }
+
+    void ClientManager::fillInbox() {
+        LOG_SCOPE;
+        auto isAnyFramePushed = false;
+        while (!inbox_.isFull()) {
+            auto frame = assembler_.takeFrame();
+            if (!frame) {
+                break;
+            }
+            inbox_.tryPush(std::move(*frame));
+            framesReceived_.store(framesReceived_.load(std::memory_order_relaxed) + 1U, std::memory_order_relaxed);
+            isAnyFramePushed = true;
+            isHeardFrom_ = true; // a whole frame, a trickle of bytes doesn't keep a connection alive
+        }
+
+        if (inbox_.isFull() && assembler_.bytesBuffered() > 0U) {
+            isReadingPaused_ = true; // set before the wakeup, so the drain that follows is sure to see it
+            isAnyFramePushed = true;
+        }
+        if (isAnyFramePushed) {
+            wakeDispatcher();
+        }
+    }
+
+    void ClientManager::wakeDispatcher() {
+        LOG_SCOPE;
+        if (!isWakeupPending_.exchange(true)) {
+            emit inboxReadySignal(this);
+        }
+    }
+
+    void ClientManager::disconnectedSlot() {
+        LOG_SCOPE;
+        if (heartbeats_ != nullptr) {
+            heartbeats_->cancel(heartbeatTimer_);
+        }
+        emit disconnectedSignal();
+    }
+
+    void ClientManager::flushSlot() {
+        LOG_SCOPE;
+        isFlushPending_ = false; // anything pushed from here on schedules another flush
+        while (auto frame = outbox_.tryPop()) {
+            outgoing_.push_back(std::move(*frame));
+        }
+        if (outgoing_.empty()) {
+            return;
+        }
+        if (socket_ == nullptr || isDisconnecting_) {
+            std::size_t bytes = 0U;
+            for (auto const &frame : outgoing_) {
+                bytes += frame.size();
+            }
+            releaseQueued(bytes);
+            outgoing_.clear();
+            return;
+        }
+
+        utils::GatherList slices{ 0U };
+        for (auto const &frame : outgoing_) {
+            slices.add(frame.data(), frame.size()); // frames relayed from one receive buffer merge into a single slice
+        }
+        auto const bytesTotal = slices.byteSize();
+        auto const bytesWritten = writeGathered(slices);
+        releaseQueued(bytesWritten); // the rest is released and counted as Qt gets it out, see bytesWrittenSlot
+        countSent(bytesWritten);
+        if (bytesWritten < bytesTotal) { // the kernel's buffer is full, or the socket has a backlog already; Qt sends the rest once it can
+            auto skip = bytesWritten;
+            for (auto const &slice : slices) {
+                if (skip >= slice.size) {
+                    skip -= slice.size;
                     continue;
                 }
-                auto msg = func::makeMessage(*pSocket);
-                emit gotDataSignal(msg.release());
-            } catch (std::logic_error const &ex) {
-                LOG_DEBUG << "Caught logic_error in clientManagerThreadFunction:\n" << ex.what() << '\n';
-            } catch (...) {
-                LOG_ERROR << "Unknown exception caught in clientManagerThreadFunction\n";
+                socket_->write(static_cast<char const *>(slice.data) + skip, static_cast<qint64>(slice.size - skip));
+                skip = 0U;
             }
+            socketWrites().add();
         }
+        framesSent().add(outgoing_.size());
+        outgoing_.clear();
     }
 
-    ClientManager::ClientManager(qintptr socketDescriptor, QObject *parent) {
+    void ClientManager::bytesWrittenSlot(qint64 bytes) {
         LOG_SCOPE;
-        auto f = std::bind(&this_type::clientManagerThreadFunction, this,
-                           std::placeholders::_1, std::placeholders::_2, std::placeholders::_3,
-                           std::placeholders::_4, std::placeholders::_5, std::placeholders::_6);
+        releaseQueued(static_cast<std::size_t>(bytes));
+        countSent(static_cast<std::size_t>(bytes));
+    }
 
-        workerThread_ = std::async(std::launch::async, std::move(f),
-                                   std::ref(initMutex_), std::ref(initDoneCv_),
-                                   std::ref(isInitialized_),
-                                   std::ref(clientInfo_), std::ref(qDataStream_),
-                                   socketDescriptor);
-        {
-            Lock lock{ initMutex_ };
-            initDoneCv_.wait(lock, [this]() -> std::atomic_bool & {
-                return isInitialized_;
-            });
+    void ClientManager::abortSlot() {
+        LOG_SCOPE;
+        if (socket_ != nullptr) {
+            socket_->abort(); // throws away the socket's buffer and emits disconnected, which cleans the connection up
         }
-        isThreadRunning_ = true;
     }
 
-    ClientManager::~ClientManager() {
+    std::size_t ClientManager::writeGathered(utils::GatherList const &slices) {
         LOG_SCOPE;
-        isThreadRunning_ = false;
-        workerThread_.get();
+#ifdef Q_OS_UNIX
+        if (socket_->bytesToWrite() > 0) { // writing past Qt's buffer would reorder the bytes
+            return 0U;
+        }
+
+        auto const fd = static_cast<int>(socket_->socketDescriptor());
+        auto iov = reinterpret_cast<iovec const *>(slices.data()); // IoSlice has the layout of iovec, see the static_asserts
+        auto remaining = slices.size();
+        std::size_t bytesWritten = 0U;
+        while (remaining > 0U) {
+            msghdr message{ }; // sendmsg rather than writev, for the flags
+            message.msg_iov = const_cast<iovec *>(iov); // only read from
+            message.msg_iovlen = static_cast<decltype(message.msg_iovlen)>(std::min<std::size_t>(remaining, IOV_MAX));
+            auto const result = ::sendmsg(fd, &message, sendFlags);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break; // EAGAIN, or an error Qt is going to report once it tries itself
+            }
+            socketWrites().add();
+
+            auto written = static_cast<std::size_t>(result);
+            bytesWritten += written;
+            while (remaining > 0U && written >= iov->iov_len) { // skip the slices that went out completely
+                written -= iov->iov_len;
+                ++iov;
+                --remaining;
+            }
+            if (written > 0U) { // a partial slice: the kernel's buffer is full
+                break;
+            }
+        }
+        return bytesWritten;
+#else
+        static_cast<void>(slices);
+        return 0U; // Qt's buffer collects everything and sends it in one go once the socket is writable
+#endif
     }
 
-    ClientManager::ClientInfo ClientManager::getClientInfo() const {
+    void ClientManager::countSent(std::size_t bytes) {
         LOG_SCOPE;
-        return clientInfo_;
+        bytesSent_.store(bytesSent_.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+        metrics::bytesSent().add(bytes);
     }
 
-    void ClientManager::writeToSocket(QByteArray data) {
+    void ClientManager::scheduleHeartbeat() {
+        LOG_SCOPE;
+        if (heartbeats_ != nullptr) {
+            heartbeatTimer_ = heartbeats_->schedule(heartbeats_->getSettings().interval, [this] {
+                heartbeatDue();
+            });
+        }
+    }
+
+    void ClientManager::heartbeatDue() {
         LOG_SCOPE;
-        qDataStream_.writeBytes(data.constData(), data.size());
+        if (isHeardFrom_) { // any frame will do to show the client is still there, it needn't be a ResHeartbeat
+            isHeardFrom_ = false;
+            missedHeartbeats_ = 0;
+        } else if (missedHeartbeats_ >= heartbeats_->getSettings().missedLimit) {
+            LOG_WARNING << "ClientManager: closing a connection that didn't answer " << missedHeartbeats_ << " heartbeats\n";
+            idleDisconnects().add();
+            socket_->abort(); // emits disconnected, which cleans the connection up
+            return;
+        } else {
+            ++missedHeartbeats_;
+            heartbeatsSent().add();
+            enqueue(HeartbeatMonitor::requestFrame());
+        }
+        scheduleHeartbeat();
     }
 
 } // END of namespace app
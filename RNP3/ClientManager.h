@@ -1,15 +1,26 @@
 #pragma once
 #include <QObject>
-#include <future>
 #include <QHostAddress>
-#include <QDataStream>
+#include <QTcpSocket>
+#include <QThread>
 #include <mutex>
-#include <condition_variable>
-#include <atomic>
+#include <memory>
 #include <QByteArray>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <vector>
+#include "SpscRing.h"
+#include "MessageQueue.h"
 #include "Types.h"
+#include "Frame.h"
+#include "FrameAssembler.h"
+#include "HeartbeatMonitor.h"
 
 namespace app {
+    // one client connection, driven by the event loop of one of the I/O threads instead of a thread of its own.
+    // frames go to the dispatcher through the inbox and to the client through the outbox, both bounded.
     class ClientManager final : public QObject {
         Q_OBJECT
     public:
@@ -24,26 +35,120 @@ namespace app {
             qint16 localPort;
         }; // END of struct ClientInfo
 
-        explicit ClientManager(qintptr socketDescriptor, QObject *parent = nullptr);
+        struct Deleter final { // the socket belongs to the I/O thread, so that's where the ClientManager has to be destroyed
+            void operator()(ClientManager *clientManager) const;
+        }; // END of struct Deleter
+
+        // shared by the owner and whoever is about to write to the connection from another thread, so it's only
+        // destroyed once the last of them is done with it. always made with a Deleter.
+        using Pointer = std::shared_ptr<ClientManager>;
+
+        struct Stats final {
+            std::uint64_t bytesReceived;
+            std::uint64_t bytesSent;
+            std::uint64_t framesReceived;
+            std::uint64_t bytesQueued; // written but not handed to the kernel yet
+        }; // END of struct Stats
+
+        enum class SlowConsumerPolicy {
+            DropChat, // chat messages are thrown away while over the watermark; the roster, errors and heartbeats still go out
+            Disconnect
+        }; // END of enum class SlowConsumerPolicy
+
+        struct SendLimits final {
+            using this_type = SendLimits;
+            std::size_t highWatermark; // the policy kicks in once more than this many bytes are waiting to be sent
+            std::size_t lowWatermark; // DropChat lets chat messages through again once it's down to this
+            std::size_t serverLimit; // past this many bytes over all connections, anyone above the low watermark is slow
+            SlowConsumerPolicy policy;
+        }; // END of struct SendLimits
+
+        static std::size_t constexpr inboxCapacity = 1024U;
+        static qint64 constexpr readBufferSize = 64 * 1024; // what Qt reads ahead from the kernel for us
+        static SendLimits constexpr defaultSendLimits{ 4U * 1024U * 1024U, 1024U * 1024U, 256U * 1024U * 1024U,
+                                                       SlowConsumerPolicy::DropChat };
+
+        // heartbeats is the monitor of ioThread, or nullptr for no heartbeats
+        ClientManager(QThread *ioThread, SendLimits sendLimits = defaultSendLimits, HeartbeatMonitor *heartbeats = nullptr);
         ~ClientManager();
+        void start(qintptr socketDescriptor); // may be called from any thread, once inboxReadySignal and disconnectedSignal are connected
         ClientInfo getClientInfo() const;
-        void writeToSocket(QByteArray);
+        void writeToSocket(QByteArray); // may be called from any thread
+        void writeToSocket(utils::Frame const &frame); // relays a received frame without re-encoding it
+        template <class Handler>
+        std::size_t drainInbox(Handler &&handler); // the dispatcher calls this once per inboxReadySignal; handler gets every queued frame
+        std::size_t getInboxDepth() const; // may be called from any thread
+        Stats getStats() const; // may be called from any thread
 
     signals:
-        void gotDataSignal(utils::Message *);
+        void inboxReadySignal(app::ClientManager *clientManager);
+        void disconnectedSignal();
+
+    private slots:
+        void initializeSlot(qintptr socketDescriptor);
+        void readyReadSlot();
+        void resumeReadingSlot();
+        void disconnectedSlot();
+        void flushSlot(); // writes everything in the outbox; only ever scheduled once per burst
+        void bytesWrittenSlot(qint64 bytes);
+        void abortSlot();
 
     private:
-        void clientManagerThreadFunction(Mutex &initMutex, std::condition_variable &initCv,
-            std::atomic_bool &isInitlialized,
-            ClientInfo &ci, QDataStream &dataStream,
-            qintptr socketDescriptor);
+        void fillInbox();
+        void wakeDispatcher();
+        void enqueue(utils::Frame frame);
+        bool isSlowConsumer() const;
+        void releaseQueued(std::size_t bytes); // the kernel has taken them
+        std::size_t writeGathered(utils::GatherList const &slices); // what the kernel took right away, without Qt's buffer in between
+        void countSent(std::size_t bytes);
+        void scheduleHeartbeat();
+        void heartbeatDue();
 
-        std::future<void> workerThread_;
+        std::unique_ptr<QTcpSocket> socket_;
+        func::FrameAssembler assembler_;
         ClientInfo clientInfo_;
-        QDataStream qDataStream_;
-        Mutex initMutex_;
-        std::atomic_bool isInitialized_;
-        std::condition_variable initDoneCv_;   
-        std::atomic_bool isThreadRunning_;
+        mutable Mutex clientInfoMutex_;
+        utils::SpscRing<utils::Frame> inbox_; // produced by the I/O thread, consumed by the dispatcher
+        std::atomic_bool isWakeupPending_; // a drain is scheduled or running
+        std::atomic<int> activeDrains_; // the destructor waits for this to drop to 0
+        utils::ThreadSafeQueue<utils::Frame> outbox_; // any thread pushes, the I/O thread pops
+        std::atomic_bool isFlushPending_; // a flushSlot has been scheduled and hasn't started taking frames out yet
+        std::vector<utils::Frame> outgoing_; // the I/O thread's batch, kept around so its capacity is reused
+        SendLimits const sendLimits_;
+        std::atomic<std::size_t> bytesQueued_; // in the outbox or in the socket's buffer
+        std::atomic_bool isCongested_; // over the high watermark and not back down to the low one yet
+        std::atomic_bool isDisconnecting_; // the Disconnect policy has struck; nothing is queued anymore
+        std::atomic_bool isReadingPaused_; // the inbox was full; the dispatcher resumes reading once it has made room
+        std::atomic<std::uint64_t> bytesReceived_; // only the I/O thread writes these three
+        std::atomic<std::uint64_t> bytesSent_;
+        std::atomic<std::uint64_t> framesReceived_;
+        HeartbeatMonitor *heartbeats_; // only the I/O thread touches these four
+        HeartbeatMonitor::TimerId heartbeatTimer_;
+        int missedHeartbeats_;
+        bool isHeardFrom_; // a frame has been received since the last time the heartbeat timer went off
     }; // END of class ClientManager
+
+    template <class Handler>
+    std::size_t ClientManager::drainInbox(Handler &&handler) {
+        ++activeDrains_;
+        std::size_t amtFrames = 0U;
+        for (;;) {
+            while (auto frame = inbox_.tryPop()) {
+                handler(std::move(*frame));
+                ++amtFrames;
+            }
+
+            if (isReadingPaused_.exchange(false)) {
+                QMetaObject::invokeMethod(this, "resumeReadingSlot", Qt::QueuedConnection);
+            }
+
+            isWakeupPending_.exchange(false); // an RMW, so it sees every frame pushed before the producer's last wakeup
+            // a frame pushed while we were busy didn't wake anyone up, so it's ours unless a new drain has been scheduled for it
+            if (inbox_.size() == 0U || isWakeupPending_.exchange(true)) {
+                break;
+            }
+        }
+        --activeDrains_; // has to be the last access to this object
+        return amtFrames;
+    }
 } // END of namespace app
@@ -0,0 +1,42 @@
+#include "FanOut.h"
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+#include "Logger.h"
+
+namespace app {
+    void FanOut::broadcast(utils::Frame const &frame, Recipients const &recipients) {
+        LOG_SCOPE;
+        std::unordered_map<QThread *, Recipients> byThread{ };
+        for (auto const &recipient : recipients) {
+            byThread[recipient.thread].push_back(recipient);
+        }
+
+        for (auto &pair : byThread) {
+            auto &group = pair.second;
+            for (std::size_t first = 0U; first < group.size(); first += batchSize) {
+                auto const last = std::min(first + batchSize, group.size());
+                Recipients batch{ std::make_move_iterator(std::begin(group) + first),
+                                  std::make_move_iterator(std::begin(group) + last) };
+                auto fanOut = new FanOut{ frame, std::move(batch), pair.first }; // deletes itself once it has run
+                QMetaObject::invokeMethod(fanOut, "runSlot", Qt::QueuedConnection);
+            }
+        }
+    }
+
+    FanOut::FanOut(utils::Frame frame, Recipients recipients, QThread *thread)
+        : Base{ nullptr }, frame_{ std::move(frame) }, recipients_{ std::move(recipients) } {
+        LOG_SCOPE;
+        moveToThread(thread);
+    }
+
+    void FanOut::runSlot() {
+        LOG_SCOPE;
+        for (auto const &recipient : recipients_) {
+            recipient.clientManager->writeToSocket(frame_); // one that has disconnected in the meantime just drops it
+        }
+        recipients_.clear(); // the last reference to a connection that's gone lets go of it here, on its own thread
+        deleteLater();
+    }
+} // END of namespace app
@@ -0,0 +1,35 @@
+#pragma once
+#include <QObject>
+#include <QThread>
+#include <cstddef>
+#include <vector>
+#include "ClientManager.h"
+#include "UserDirectory.h"
+#include "Frame.h"
+
+namespace app {
+    // delivers one encoded frame to many connections.
+    // every recipient gets the very same reference counted buffer, so the frame is neither re-encoded nor copied per recipient.
+    // the recipients are split by I/O thread into batches, and each batch is written by the thread its connections live on,
+    // so sending to a huge group only costs the dispatching thread a handful of posted events.
+    class FanOut final : public QObject {
+        Q_OBJECT
+    public:
+        using this_type = FanOut;
+        using Base = QObject;
+        using Recipients = std::vector<Connection>; // held on to until their batch has been written
+
+        static std::size_t constexpr batchSize = 256U;
+
+        static void broadcast(utils::Frame const &frame, Recipients const &recipients); // may be called from any thread
+
+    private slots:
+        void runSlot();
+
+    private:
+        FanOut(utils::Frame frame, Recipients recipients, QThread *thread);
+
+        utils::Frame frame_;
+        Recipients recipients_;
+    }; // END of class FanOut
+} // END of namespace app
@@ -0,0 +1,64 @@
+#include "Frame.h"
+#include <utility>
+#include "WireFormat.h"
+#include "Logger.h"
+
+namespace utils {
+    Frame::Frame()
+        : buffer_{ }, offset_{ 0 }, size_{ 0 } {
+        LOG_SCOPE;
+    }
+
+    Frame::Frame(QByteArray buffer, int offset, int size)
+        : buffer_{ std::move(buffer) }, offset_{ offset }, size_{ size } {
+        LOG_SCOPE;
+    }
+
+    char const *Frame::data() const {
+        LOG_SCOPE;
+        return buffer_.constData() + offset_;
+    }
+
+    std::size_t Frame::size() const {
+        LOG_SCOPE;
+        return static_cast<std::size_t>(size_);
+    }
+
+    bool Frame::isEmpty() const {
+        LOG_SCOPE;
+        return size_ == 0;
+    }
+
+    char const *Frame::body() const {
+        LOG_SCOPE;
+        return data() + commonHeaderByteSize;
+    }
+
+    Word Frame::getVersion() const {
+        LOG_SCOPE;
+        return wire::CommonHeader::load<wire::CommonHeader::version>(data());
+    }
+
+    MessageType Frame::getType() const {
+        LOG_SCOPE;
+        return wire::CommonHeader::load<wire::CommonHeader::type>(data());
+    }
+
+    Word Frame::getLength() const {
+        LOG_SCOPE;
+        return wire::CommonHeader::load<wire::CommonHeader::length>(data());
+    }
+
+    QByteArray const &Frame::getBuffer() const {
+        LOG_SCOPE;
+        return buffer_;
+    }
+
+    Frame Frame::compacted() const {
+        LOG_SCOPE;
+        if (offset_ == 0 && size_ == buffer_.size()) {
+            return *this;
+        }
+        return Frame{ QByteArray{ data(), size_ }, 0, size_ };
+    }
+} // END of namespace utils
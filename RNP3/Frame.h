@@ -0,0 +1,33 @@
+#pragma once
+#include "Types.h"
+#include <cstddef>
+#include <QByteArray>
+#include <QMetaType>
+
+namespace utils {
+    // one complete frame inside a reference counted receive buffer.
+    // copying a Frame only bumps the reference count of the buffer, the bytes themselves are never copied.
+    class Frame final {
+    public:
+        using this_type = Frame;
+
+        Frame();
+        Frame(QByteArray buffer, int offset, int size);
+        char const *data() const;
+        std::size_t size() const;
+        bool isEmpty() const;
+        char const *body() const; // the bytes following the common header
+        Word getVersion() const;
+        MessageType getType() const;
+        Word getLength() const;
+        QByteArray const &getBuffer() const;
+        Frame compacted() const; // a frame with a buffer of its own that holds nothing but this frame
+
+    private:
+        QByteArray buffer_;
+        int offset_;
+        int size_;
+    }; // END of class Frame
+} // END of namespace utils
+
+Q_DECLARE_METATYPE(utils::Frame)
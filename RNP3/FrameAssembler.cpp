@@ -0,0 +1,121 @@
+#include "FrameAssembler.h"
+#include "functions.h"
+#include <utility>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "Logger.h"
+
+namespace {
+    auto constexpr maxBufferSize = std::numeric_limits<int>::max(); // QByteArray's sizes are ints
+} // END of anonymous namespace
+
+namespace func {
+    FrameAssembler::FrameAssembler()
+        : buffer_{ }, readPos_{ 0 }, progress_{ } {
+        LOG_SCOPE;
+    }
+
+    FrameAssembler::~FrameAssembler() {
+        LOG_SCOPE;
+        utils::BufferPool::forCurrentThread().release(std::move(buffer_));
+    }
+
+    qint64 FrameAssembler::readFrom(QIODevice &device) {
+        LOG_SCOPE;
+        if (device.bytesAvailable() <= 0) {
+            return 0;
+        }
+
+        // should the device have more than the buffer can hold, the rest stays in the device until the next call
+        compact();
+        auto const bytesAvailable = std::min<qint64>(device.bytesAvailable(), maxBufferSize - buffer_.size());
+        reserve(static_cast<int>(bytesAvailable));
+        auto const oldSize = buffer_.size();
+        buffer_.resize(oldSize + static_cast<int>(bytesAvailable));
+        auto const bytesRead = device.read(buffer_.data() + oldSize, bytesAvailable);
+        if (bytesRead < 0) {
+            LOG_WARNING << "FrameAssembler::readFrom: failed to read from the device\n";
+            buffer_.resize(oldSize);
+            return 0;
+        }
+
+        buffer_.resize(oldSize + static_cast<int>(bytesRead));
+        LOG_DEBUG << "FrameAssembler::readFrom: " << bytesRead << " bytes read, " << bytesBuffered() << " bytes buffered\n";
+        return bytesRead;
+    }
+
+    void FrameAssembler::append(char const *data, std::size_t size) {
+        LOG_SCOPE;
+        compact();
+        if (size > static_cast<std::size_t>(maxBufferSize - buffer_.size())) {
+            throw std::length_error{ "too many bytes for the buffer in FrameAssembler::append" };
+        }
+        reserve(static_cast<int>(size));
+        buffer_.append(data, static_cast<int>(size));
+    }
+
+    std::optional<utils::Frame> FrameAssembler::takeFrame() {
+        LOG_SCOPE;
+        auto const scan = scanFrame(buffer_.constData() + readPos_, bytesBuffered(), &progress_);
+        switch (scan.status) {
+            case DecodeStatus::Complete : { // no larger than maxFrameSize, so it fits into an int
+                utils::Frame frame{ buffer_, readPos_, static_cast<int>(scan.frameSize) };
+                readPos_ += static_cast<int>(scan.frameSize);
+                progress_ = ScanProgress{ };
+                return frame;
+            }
+            case DecodeStatus::NeedMoreData : {
+                return std::nullopt;
+            }
+            case DecodeStatus::Malformed : {
+                break;
+            }
+        } // END switch (scan.status)
+
+        clear(); // the stream can't be resynchronized after a malformed header
+        throw std::logic_error{ scan.error };
+    }
+
+    std::size_t FrameAssembler::bytesBuffered() const {
+        LOG_SCOPE;
+        return static_cast<std::size_t>(buffer_.size() - readPos_);
+    }
+
+    void FrameAssembler::clear() {
+        LOG_SCOPE;
+        utils::BufferPool::forCurrentThread().release(std::move(buffer_));
+        buffer_ = QByteArray{ };
+        readPos_ = 0;
+        progress_ = ScanProgress{ };
+    }
+
+    void FrameAssembler::compact() {
+        LOG_SCOPE;
+        if (readPos_ == 0) {
+            return;
+        }
+
+        auto &pool = utils::BufferPool::forCurrentThread();
+        if (readPos_ == buffer_.size()) {
+            pool.release(std::move(buffer_)); // the frames handed out keep their own reference to the old buffer
+            buffer_ = QByteArray{ };
+        } else if (buffer_.isDetached()) {
+            buffer_.remove(0, readPos_); // only ever moves the tail of a partial frame
+        } else { // frames still point into the old buffer, so it mustn't be modified
+            auto const tailSize = buffer_.size() - readPos_;
+            auto tail = pool.acquire(tailSize);
+            tail.append(buffer_.constData() + readPos_, tailSize);
+            pool.release(std::move(buffer_));
+            buffer_ = std::move(tail);
+        }
+        readPos_ = 0;
+    }
+
+    void FrameAssembler::reserve(int bytesToAdd) {
+        LOG_SCOPE;
+        if (buffer_.capacity() == 0) {
+            buffer_ = utils::BufferPool::forCurrentThread().acquire(bytesToAdd);
+        }
+    }
+} // END of namespace func
@@ -0,0 +1,39 @@
+#pragma once
+#include "Types.h"
+#include "Frame.h"
+#include "BufferPool.h"
+#include "functions.h"
+#include <cstddef>
+#include <optional>
+#include <QByteArray>
+#include <QIODevice>
+
+namespace func {
+    // accumulates the bytes of one connection and hands out frames once they are complete.
+    // never blocks: if a frame is only partially there it simply stays buffered until the rest arrives.
+    // the frames handed out share the receive buffer, so nothing is copied on their way to the dispatcher.
+    // the receive buffers come from the BufferPool of the thread the assembler is used on.
+    // this is the adapter between a transport and the codec: it only buffers bytes, finding the frames is up to func::scanFrame.
+    class FrameAssembler final {
+    public:
+        using this_type = FrameAssembler;
+
+        FrameAssembler();
+        FrameAssembler(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+        ~FrameAssembler();
+        qint64 readFrom(QIODevice &device); // moves everything the device (a socket, usually) has buffered in one bulk read
+        void append(char const *data, std::size_t size); // std::length_error if the buffer can't hold that many more bytes
+        std::optional<utils::Frame> takeFrame(); // std::nullopt if there's no complete frame yet; std::logic_error if it's malformed
+        std::size_t bytesBuffered() const;
+        void clear();
+
+    private:
+        void compact();
+        void reserve(int bytesToAdd); // makes room for bytesToAdd more bytes, taking a buffer from the pool if there is none
+
+        QByteArray buffer_;
+        int readPos_; // everything before readPos_ has already been handed out as frames
+        ScanProgress progress_; // how far scanFrame got with the frame at readPos_
+    }; // END of class FrameAssembler
+} // END of namespace func
@@ -0,0 +1,78 @@
+#include "GatherList.h"
+#include <stdexcept>
+#include <array>
+#include "Logger.h"
+
+namespace {
+    std::array<char, 256> const zeros{ }; // padding is referenced from here instead of taking up scratch space
+} // END of anonymous namespace
+
+namespace utils {
+    GatherList::GatherList(std::size_t scratchCapacity)
+        : slices_{ }, scratch_(scratchCapacity), scratchUsed_{ 0U }, byteSize_{ 0U } {
+        LOG_SCOPE;
+        slices_.reserve(4U);
+    }
+
+    char *GatherList::allocateScratch(std::size_t size) {
+        LOG_SCOPE;
+        if (scratchUsed_ + size > scratch_.size()) {
+            throw std::logic_error{ "scratch space exhausted in GatherList::allocateScratch" };
+        }
+
+        auto const ret = scratch_.data() + scratchUsed_;
+        scratchUsed_ += size;
+        return ret;
+    }
+
+    void GatherList::add(void const *data, std::size_t size) {
+        LOG_SCOPE;
+        if (size == 0U) {
+            return;
+        }
+
+        byteSize_ += size;
+        if (!slices_.empty()) {
+            auto &last = slices_.back();
+            if (static_cast<char const *>(last.data) + last.size == data) {
+                last.size += size;
+                return;
+            }
+        }
+        slices_.push_back(IoSlice{ data, size });
+    }
+
+    void GatherList::addZeros(std::size_t size) {
+        LOG_SCOPE;
+        while (size > 0U) {
+            auto const chunk = size < zeros.size() ? size : zeros.size();
+            add(zeros.data(), chunk);
+            size -= chunk;
+        }
+    }
+
+    IoSlice const *GatherList::data() const {
+        LOG_SCOPE;
+        return slices_.data();
+    }
+
+    std::size_t GatherList::size() const {
+        LOG_SCOPE;
+        return slices_.size();
+    }
+
+    std::size_t GatherList::byteSize() const {
+        LOG_SCOPE;
+        return byteSize_;
+    }
+
+    GatherList::const_iterator GatherList::begin() const {
+        LOG_SCOPE;
+        return slices_.cbegin();
+    }
+
+    GatherList::const_iterator GatherList::end() const {
+        LOG_SCOPE;
+        return slices_.cend();
+    }
+} // END of namespace utils
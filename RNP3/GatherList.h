@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace utils {
+    struct IoSlice final { // the layout matches struct iovec, so the slices can be handed to writev as they are
+        using this_type = IoSlice;
+        void const *data;
+        std::size_t size;
+    }; // END of struct IoSlice
+
+    // describes a frame as a list of slices: the fixed size parts live in the list's scratch space,
+    // the variable length payloads (message texts, usernames) are referenced in place and never copied.
+    class GatherList final {
+    public:
+        using this_type = GatherList;
+        using container_type = std::vector<IoSlice>;
+        using const_iterator = container_type::const_iterator;
+
+        explicit GatherList(std::size_t scratchCapacity); // the scratch space is never reallocated, so it has to be large enough up front
+        GatherList(this_type const &) = delete; // a copy's slices would still point into the original's scratch space
+        this_type &operator=(this_type const &) = delete;
+        GatherList(this_type &&) = default; // moving keeps the scratch space where it is
+        this_type &operator=(this_type &&) = default;
+        char *allocateScratch(std::size_t size);
+        void add(void const *data, std::size_t size); // merges with the previous slice if the two are contiguous
+        void addZeros(std::size_t size);
+        IoSlice const *data() const;
+        std::size_t size() const; // the amount of slices
+        std::size_t byteSize() const; // the amount of bytes described by all the slices
+        const_iterator begin() const;
+        const_iterator end() const;
+
+    private:
+        container_type slices_;
+        std::vector<char> scratch_;
+        std::size_t scratchUsed_;
+        std::size_t byteSize_;
+    }; // END of class GatherList
+} // END of namespace utils
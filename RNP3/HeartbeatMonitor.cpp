@@ -0,0 +1,71 @@
+#include "HeartbeatMonitor.h"
+#include <utility>
+#include "Types.h"
+#include "Logger.h"
+
+namespace {
+    utils::Frame encode(QByteArray bytes) {
+        LOG_SCOPE;
+        auto const size = bytes.size();
+        return utils::Frame{ std::move(bytes), 0, size };
+    }
+} // END of anonymous namespace
+
+namespace app {
+    HeartbeatMonitor::HeartbeatMonitor(QThread *thread, Settings settings)
+        : Base{ nullptr }, settings_{ settings }, wheel_{ }, timer_{ nullptr }, start_{ Clock::now() } {
+        LOG_SCOPE;
+        moveToThread(thread);
+        QMetaObject::invokeMethod(this, "startSlot", Qt::QueuedConnection);
+    }
+
+    HeartbeatMonitor::Settings HeartbeatMonitor::getSettings() const {
+        LOG_SCOPE;
+        return settings_;
+    }
+
+    HeartbeatMonitor::TimerId HeartbeatMonitor::schedule(int delay, utils::TimerWheel::Callback callback) {
+        LOG_SCOPE;
+        // the wheel may lag behind the clock by up to a tick, which the delay makes up for
+        auto const elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_).count();
+        auto const lag = static_cast<utils::TimerWheel::Tick>(elapsed / tickInterval) - wheel_.now();
+        return wheel_.schedule(static_cast<utils::TimerWheel::Tick>((delay + tickInterval - 1) / tickInterval) + lag,
+                               std::move(callback));
+    }
+
+    void HeartbeatMonitor::cancel(TimerId id) {
+        LOG_SCOPE;
+        wheel_.cancel(id);
+    }
+
+    utils::Frame const &HeartbeatMonitor::requestFrame() {
+        LOG_SCOPE;
+        static auto const frame = encode(utils::ReqHeartbeatMessage{ utils::protocolVersion, utils::MessageType::reqHeartbeat, 0U }.toByteArray());
+        return frame;
+    }
+
+    utils::Frame const &HeartbeatMonitor::responseFrame() {
+        LOG_SCOPE;
+        static auto const frame = encode(utils::ResHeartbeatMessage{ utils::protocolVersion, utils::MessageType::resHeartbeat, 0U }.toByteArray());
+        return frame;
+    }
+
+    void HeartbeatMonitor::startSlot() {
+        LOG_SCOPE;
+        timer_ = std::make_unique<QTimer>();
+        connect(timer_.get(), SIGNAL(timeout()), this, SLOT(tickSlot()));
+        // stopped from its own thread, as the monitor itself is only destroyed once the thread is gone
+        connect(thread(), SIGNAL(finished()), timer_.get(), SLOT(stop()), Qt::DirectConnection);
+        timer_->start(tickInterval);
+    }
+
+    void HeartbeatMonitor::tickSlot() {
+        LOG_SCOPE;
+        // the timer's ticks come late when the thread is busy; the wheel catches up with the clock instead of drifting
+        auto const elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_).count();
+        auto const due = static_cast<utils::TimerWheel::Tick>(elapsed / tickInterval);
+        if (due > wheel_.now()) {
+            wheel_.advance(due - wheel_.now());
+        }
+    }
+} // END of namespace app
@@ -0,0 +1,50 @@
+#pragma once
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <chrono>
+#include <memory>
+#include "TimerWheel.h"
+#include "Frame.h"
+
+namespace app {
+    // keeps the heartbeat timers of all the connections on one I/O thread in a single timer wheel,
+    // which a single QTimer advances, instead of every connection running a timer of its own.
+    // everything but the constructor has to be called on the monitor's thread.
+    class HeartbeatMonitor final : public QObject {
+        Q_OBJECT
+    public:
+        using this_type = HeartbeatMonitor;
+        using Base = QObject;
+        using TimerId = utils::TimerWheel::TimerId;
+        using Clock = std::chrono::steady_clock;
+
+        struct Settings final {
+            using this_type = Settings;
+            int interval; // ms of silence before a connection is sent a ReqHeartbeat; 0 turns the heartbeats off
+            int missedLimit; // unanswered heartbeats after which the connection is closed
+        }; // END of struct Settings
+
+        static int constexpr tickInterval = 100; // ms; the resolution of the timers
+        static Settings constexpr defaultSettings{ 10000, 3 };
+
+        HeartbeatMonitor(QThread *thread, Settings settings);
+        HeartbeatMonitor(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+        Settings getSettings() const;
+        TimerId schedule(int delay, utils::TimerWheel::Callback callback); // delay in ms
+        void cancel(TimerId id);
+        static utils::Frame const &requestFrame(); // the ReqHeartbeat and ResHeartbeat are encoded once and shared by everyone
+        static utils::Frame const &responseFrame();
+
+    private slots:
+        void startSlot();
+        void tickSlot();
+
+    private:
+        Settings settings_;
+        utils::TimerWheel wheel_;
+        std::unique_ptr<QTimer> timer_; // created on the monitor's thread
+        Clock::time_point start_;
+    }; // END of class HeartbeatMonitor
+} // END of namespace app
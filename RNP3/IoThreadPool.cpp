@@ -0,0 +1,52 @@
+#include "IoThreadPool.h"
+#include <QString>
+#include "Logger.h"
+
+namespace app {
+    IoThreadPool::IoThreadPool(int threadCount)
+        : threads_{ }, nextThread_{ 0U } {
+        LOG_SCOPE;
+        if (threadCount < 1) {
+            threadCount = 1;
+        }
+
+        for (auto i = 0; i < threadCount; ++i) {
+            threads_.push_back(std::make_unique<QThread>());
+            threads_.back()->setObjectName(QString{ "IoThread" } + QString::number(i));
+            threads_.back()->start();
+        }
+        LOG_DEBUG << "IoThreadPool: started " << threadCount << " I/O threads\n";
+    }
+
+    IoThreadPool::~IoThreadPool() {
+        LOG_SCOPE;
+        stop();
+    }
+
+    QThread *IoThreadPool::next() {
+        LOG_SCOPE;
+        auto thread = threads_[nextThread_].get();
+        nextThread_ = (nextThread_ + 1U) % threads_.size();
+        return thread;
+    }
+
+    QThread *IoThreadPool::at(int index) const {
+        LOG_SCOPE;
+        return threads_.at(static_cast<std::size_t>(index)).get();
+    }
+
+    int IoThreadPool::size() const {
+        LOG_SCOPE;
+        return static_cast<int>(threads_.size());
+    }
+
+    void IoThreadPool::stop() {
+        LOG_SCOPE;
+        for (auto &thread : threads_) {
+            thread->quit();
+        }
+        for (auto &thread : threads_) {
+            thread->wait();
+        }
+    }
+} // END of namespace app
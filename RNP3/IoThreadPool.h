@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <QThread>
+
+namespace app {
+    // a small, fixed amount of threads that each run an event loop.
+    // every connection is assigned to one of them, so the amount of threads doesn't grow with the amount of clients.
+    class IoThreadPool final {
+    public:
+        using this_type = IoThreadPool;
+        using container_type = std::vector<std::unique_ptr<QThread>>;
+
+        explicit IoThreadPool(int threadCount);
+        IoThreadPool(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+        ~IoThreadPool();
+        QThread *next(); // hands out the threads round robin
+        QThread *at(int index) const;
+        int size() const;
+        void stop(); // quits the event loops and waits for the threads to finish
+
+    private:
+        container_type threads_;
+        std::size_t nextThread_;
+    }; // END of class IoThreadPool
+} // END of namespace app
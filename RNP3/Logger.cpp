@@ -1,5 +1,7 @@
 #include "Logger.h"
+#include "Profiler.h"
 #include <utility> // std::move
+#include <algorithm> // std::min, std::remove_if
 #include <mutex>
 
 namespace logging {
@@ -10,39 +12,249 @@ namespace logging {
         return std::runtime_error::what();
     }
 
+    namespace detail {
+        RecordRing::RecordRing(std::size_t capacity)
+            : bytes_{ }, mask_{ 0U }, head_{ 0U }, tail_{ 0U }, isAbandoned_{ false } {
+            std::size_t roundedCapacity = 1U;
+            while (roundedCapacity < capacity) {
+                roundedCapacity <<= 1U;
+            }
+            bytes_.resize(roundedCapacity);
+            mask_ = roundedCapacity - 1U;
+        }
+
+        bool RecordRing::tryWrite(char const *text, std::size_t size) {
+            auto const tail = tail_.load(std::memory_order_relaxed);
+            if (size > bytes_.size() - (tail - head_.load(std::memory_order_acquire))) {
+                return false;
+            }
+            auto const offset = tail & mask_;
+            auto const firstPart = std::min(size, bytes_.size() - offset); // the rest wraps around to the front
+            std::copy(text, text + firstPart, bytes_.data() + offset);
+            std::copy(text + firstPart, text + size, bytes_.data());
+            tail_.store(tail + size, std::memory_order_release); // publishes the whole record at once
+            return true;
+        }
+
+        std::size_t RecordRing::drainTo(std::string &out) {
+            auto const head = head_.load(std::memory_order_relaxed);
+            auto const size = tail_.load(std::memory_order_acquire) - head;
+            auto const offset = head & mask_;
+            auto const firstPart = std::min(size, bytes_.size() - offset);
+            out.append(bytes_.data() + offset, firstPart);
+            out.append(bytes_.data(), size - firstPart);
+            head_.store(head + size, std::memory_order_release); // hands the space back to the producer
+            return size;
+        }
+
+        std::size_t RecordRing::size() const {
+            auto const head = head_.load(std::memory_order_acquire);
+            return tail_.load(std::memory_order_acquire) - head;
+        }
+
+        std::size_t RecordRing::capacity() const {
+            return bytes_.size();
+        }
+
+        void RecordRing::abandon() {
+            isAbandoned_ = true;
+        }
+
+        bool RecordRing::isAbandoned() const {
+            return isAbandoned_;
+        }
+    } // END of namespace detail
+
+    Record::Record(Logger &logger) : logger_{ logger }, size_{ 0U } {
+        auto curTimestamp = std::chrono::steady_clock::now() - Logger::baseTimestamp_;
+        *this << std::chrono::duration_cast<std::chrono::microseconds>(curTimestamp).count() << "us: ";
+    }
+
+    Record::~Record() {
+        logger_.submit(text_.data(), size_);
+    }
+
+    void Record::append(std::string_view text) {
+        append(text.data(), text.size());
+    }
+
+    void Record::append(char const *text, std::size_t size) {
+        auto const amtToCopy = std::min(size, capacity - size_);
+        std::copy(text, text + amtToCopy, text_.data() + size_);
+        size_ += amtToCopy;
+        if (amtToCopy < size) { // cut off; make sure the record still ends its line
+            text_[capacity - 1U] = '\n';
+        }
+    }
+
     Logger::this_type &Logger::getLogger() {
         static this_type instance{ };
         return instance;
     }
 
-    Logger::value_type &Logger::log() {
-        auto curTimestamp = std::chrono::steady_clock::now() - baseTimestamp_;
-        logfile_ << std::chrono::duration_cast<std::chrono::microseconds>(curTimestamp).count() << "us: ";
-        return logfile_;
+    Logger::value_type Logger::log() {
+        return value_type{ *this };
     }
 
     void Logger::setLogLevel(LogLevel logLevel) {
-        level_ = logLevel;
+        detail::currentLevel = logLevel;
+        if (isLevelEnabled(LogLevel::Debug)) {
+            detail::scopeFlags |= detail::scopeTraceFlag;
+        } else {
+            detail::scopeFlags &= ~detail::scopeTraceFlag;
+        }
     }
 
     LogLevel Logger::getLogLevel() const {
-        return level_;
+        return detail::currentLevel.load(std::memory_order_relaxed);
+    }
+
+    void Logger::setOverflowPolicy(OverflowPolicy overflowPolicy) {
+        overflowPolicy_ = overflowPolicy;
+    }
+
+    OverflowPolicy Logger::getOverflowPolicy() const {
+        return overflowPolicy_;
+    }
+
+    std::size_t Logger::getDroppedCount() const {
+        return droppedCount_;
+    }
+
+    void Logger::flush() {
+        Lock lock{ wakeUpMutex_ };
+        if (isStopping_) {
+            return;
+        }
+        auto const ticket = ++flushRequests_;
+        wakeUp_.notify_one();
+        flushed_.wait(lock, [this, ticket] {
+            return flushesDone_ >= ticket;
+        });
+    }
+
+    void Logger::submit(char const *text, std::size_t size) {
+        auto &ring = ringForCurrentThread();
+        while (!ring.tryWrite(text, size)) {
+            if (overflowPolicy_ == OverflowPolicy::Drop) {
+                ++droppedCount_;
+                return;
+            }
+            wakeUp_.notify_one();
+            std::this_thread::yield();
+        }
+
+        if (ring.size() >= ring.capacity() / 2U) { // don't wait for the next interval, the ring is filling up
+            wakeUp_.notify_one();
+        }
+    }
+
+    detail::RecordRing &Logger::ringForCurrentThread() {
+        struct RingHolder final {
+            ~RingHolder() {
+                if (ring != nullptr) {
+                    ring->abandon();
+                }
+            }
+
+            std::shared_ptr<detail::RecordRing> ring;
+        }; // END of struct RingHolder
+
+        thread_local RingHolder holder{ };
+        if (holder.ring == nullptr) {
+            holder.ring = std::make_shared<detail::RecordRing>(ringCapacity);
+            Lock lock{ ringsMutex_ };
+            rings_.push_back(holder.ring);
+        }
+        return *holder.ring;
     }
 
-    Logger::Logger() : level_{ LogLevel::Debug }, logfile_{ file_, openMode_ } { }
+    void Logger::flusherThreadFunction() {
+        std::string batch{ };
+        batch.reserve(ringCapacity);
+        for (;;) {
+            std::uint64_t flushRequests = 0U;
+            auto isStopping = false;
+            {
+                Lock lock{ wakeUpMutex_ };
+                if (!isStopping_ && flushRequests_ == flushesDone_) {
+                    wakeUp_.wait_for(lock, flushInterval);
+                }
+                flushRequests = flushRequests_;
+                isStopping = isStopping_;
+            }
+
+            drainRings(batch);
+            if (!batch.empty()) {
+                logfile_.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+                logfile_.flush();
+                batch.clear();
+            }
+
+            {
+                Lock lock{ wakeUpMutex_ };
+                flushesDone_ = flushRequests;
+            }
+            flushed_.notify_all();
+            if (isStopping) {
+                return;
+            }
+        }
+    }
+
+    void Logger::drainRings(std::string &batch) {
+        Lock lock{ ringsMutex_ };
+        for (auto &ring : rings_) {
+            auto const isAbandoned = ring->isAbandoned(); // checked first: nothing gets written after it's set
+            ring->drainTo(batch);
+            if (isAbandoned) {
+                ring.reset();
+            }
+        }
+        rings_.erase(std::remove(std::begin(rings_), std::end(rings_), nullptr), std::end(rings_));
+    }
+
+    Logger::Logger()
+        : overflowPolicy_{ OverflowPolicy::Block }, droppedCount_{ 0U },
+          logfile_{ file_, openMode_ }, ringsMutex_{ }, rings_{ }, wakeUpMutex_{ }, wakeUp_{ }, flushed_{ },
+          flushRequests_{ 0U }, flushesDone_{ 0U }, isStopping_{ false }, flusher_{ } {
+        if (!logfile_) {
+            throw LoggerException{ "could not open file_ for logging." };
+        }
+        flusher_ = std::thread{ &this_type::flusherThreadFunction, this };
+    }
+
+    Logger::~Logger() {
+        {
+            Lock lock{ wakeUpMutex_ };
+            isStopping_ = true;
+        }
+        wakeUp_.notify_one();
+        flusher_.join(); // the flusher empties the rings one last time before it returns
+    }
 
     std::string const Logger::file_ = __DATE__ " LogFile.txt";
     std::ios::openmode const Logger::openMode_ = std::ios::trunc;
     std::chrono::time_point<std::chrono::steady_clock> const Logger::baseTimestamp_ = std::chrono::steady_clock::now();
 
-    LogScope::LogScope(value_type val) noexcept : func_{ std::move(val) },
-        logger_{ Logger::getLogger() } {
-
-        LOG_DEBUG << "Entering function " << func_ << '\n';
+    void LogScope::enter() {
+        if ((flags_ & detail::scopeTraceFlag) != 0U) {
+            Logger::getLogger().log() << "Entering function " << site_.function << '\n';
+        }
+        if ((flags_ & detail::scopeProfileFlag) != 0U) {
+            start_ = profiling::Profiler::now(); // last, so the record above isn't part of the measurement
+        }
     }
 
-    LogScope::~LogScope() {
-        LOG_DEBUG << "Exiting function " << func_ << '\n';
+    void LogScope::exit() const {
+        if ((flags_ & detail::scopeProfileFlag) != 0U) {
+            auto const end = profiling::Profiler::now();
+            profiling::Profiler::getProfiler().record(site_, start_, end - start_,
+                                                      (flags_ & detail::scopeCaptureFlag) != 0U);
+        }
+        if ((flags_ & detail::scopeTraceFlag) != 0U) {
+            Logger::getLogger().log() << "Exiting function " << site_.function << '\n';
+        }
     }
 
 } // END of namespace logging
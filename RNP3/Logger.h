@@ -1,24 +1,60 @@
 #pragma once
 #include <fstream> // std::ofstream
 #include <string> // std::string
+#include <string_view> // std::string_view
 #include <stdexcept> // std::runtime_error
 #include <chrono>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio> // std::snprintf
+#include <charconv> // std::to_chars
+#include <sstream> // std::ostringstream
+#include <type_traits>
 #if defined(LOG_ERROR) || defined (LOG_WARNING) || defined(LOG_DEBUG) || defined(SET_LOG_LEVEL_ERROR) || defined(SET_LOG_LEVEL_WARNING) || defined(SET_LOG_LEVEL_DEBUG)
 static_assert(false, "One or multiple logging macros were already defined in Logger.cpp");
 #endif
 #if defined(CONCAT_IMPL) || defined(MACRO_CONCAT)
 static_assert(false, "CONCAT_IMPL or MACRO_CONCAT already defined in Logger.cpp");
 #endif
+#if defined(LOG_LEVEL_CEILING) && (LOG_LEVEL_CEILING < 0 || LOG_LEVEL_CEILING > 2)
+static_assert(false, "LOG_LEVEL_CEILING has to be 0 (Error), 1 (Warning) or 2 (Debug)");
+#endif
+#ifndef LOG_LEVEL_CEILING // the most verbose level that is compiled in at all; release builds leave out debug logging and LOG_SCOPE
+#   ifdef NDEBUG
+#       define LOG_LEVEL_CEILING 1
+#   else
+#       define LOG_LEVEL_CEILING 2
+#   endif
+#endif
+#ifndef ENABLE_PROFILER // whether LOG_SCOPE feeds the profiler; can be switched on for release builds on its own
+#   ifdef NDEBUG
+#       define ENABLE_PROFILER 0
+#   else
+#       define ENABLE_PROFILER 1
+#   endif
+#endif
 #define CONCAT_IMPL(x, y) x##y
 #define MACRO_CONCAT(x, y) CONCAT_IMPL(x, y)
-#define LOG_ERROR	if (logging::Logger::getLogger().getLogLevel() >= logging::LogLevel::Error) logging::Logger::getLogger().log()
-#define LOG_WARNING	if (logging::Logger::getLogger().getLogLevel() >= logging::LogLevel::Warning) logging::Logger::getLogger().log()
-#define LOG_DEBUG	if (logging::Logger::getLogger().getLogLevel() >= logging::LogLevel::Debug) logging::Logger::getLogger().log()
+#define LOG_ERROR	if (logging::isLevelEnabled(logging::LogLevel::Error)) logging::Logger::getLogger().log()
+#define LOG_WARNING	if (logging::isLevelEnabled(logging::LogLevel::Warning)) logging::Logger::getLogger().log()
+#define LOG_DEBUG	if (logging::isLevelEnabled(logging::LogLevel::Debug)) logging::Logger::getLogger().log()
 #define SET_LOG_LEVEL_ERROR		logging::Logger::getLogger().setLogLevel(logging::LogLevel::Error)
 #define SET_LOG_LEVEL_WARNING	logging::Logger::getLogger().setLogLevel(logging::LogLevel::Warning)
 #define SET_LOG_LEVEL_DEBUG		logging::Logger::getLogger().setLogLevel(logging::LogLevel::Debug)
-#define LOG_SCOPE				logging::LogScope MACRO_CONCAT(logScope_AbCTNHTNEhaANeitnTTOmmoniaet_a, __COUNTER__){ __func__ }
+#define LOG_SCOPE_IMPL(id)		static logging::ScopeSite const MACRO_CONCAT(scopeSite_AbCTNHTNEhaANeitnTTOmmoniaet_a, id){ __func__, __FILE__, __LINE__ }; \
+								logging::LogScope MACRO_CONCAT(logScope_AbCTNHTNEhaANeitnTTOmmoniaet_a, id){ MACRO_CONCAT(scopeSite_AbCTNHTNEhaANeitnTTOmmoniaet_a, id) }
+#if LOG_LEVEL_CEILING >= 2 || ENABLE_PROFILER
+#   define LOG_SCOPE			LOG_SCOPE_IMPL(__COUNTER__)
+#else
+#   define LOG_SCOPE			static_cast<void>(0)
+#endif
 
 namespace logging {
     class LoggerException : public std::runtime_error {
@@ -30,36 +66,32 @@ namespace logging {
 
 
     namespace detail {
-        class ThreadSafeOfStreamWrapper final {
+        // the text one thread has logged that the flusher hasn't written yet.
+        // exactly one producer (the thread that owns it) and one consumer (the flusher);
+        // a record is published in one go, so the flusher never sees half of one.
+        class RecordRing final {
         public:
-            using this_type = ThreadSafeOfStreamWrapper;
-            using Mutex = std::mutex;
-            using Lock = std::lock_guard<Mutex>;
-
-            template <class ...Args>
-            explicit ThreadSafeOfStreamWrapper(Args &&...args)
-                : ofstream_{ std::forward<Args>(args)... } {
-                
-                if (!ofstream_) {
-                    throw LoggerException{ "could not open file_ for logging." };
-                }
-            }
+            using this_type = RecordRing;
 
-            template <class Type>
-            friend this_type &operator<<(this_type &stream, Type &&type) {
-                Lock lock{ stream.mutex_ };
-                stream.ofstream_ << std::forward<Type>(type);
-                return stream;
-            }
-
-            ~ThreadSafeOfStreamWrapper() {
-                ofstream_ << std::flush;
-            }
+            explicit RecordRing(std::size_t capacity); // rounded up to the next power of two
+            RecordRing(this_type const &) = delete;
+            this_type &operator=(this_type const &) = delete;
+            bool tryWrite(char const *text, std::size_t size); // producer only; false if there isn't room for all of it
+            std::size_t drainTo(std::string &out); // consumer only; appends everything published so far
+            std::size_t size() const;
+            std::size_t capacity() const;
+            void abandon(); // the owning thread has exited; the ring goes away once the flusher has emptied it
+            bool isAbandoned() const;
 
         private:
-            Mutex mutex_;
-            std::ofstream ofstream_;
-        }; // END of class ThreadSafeOfStreamWrapper
+            static std::size_t constexpr cacheLineSize = 64U;
+
+            std::vector<char> bytes_;
+            std::size_t mask_;
+            alignas(cacheLineSize) std::atomic<std::size_t> head_; // only the consumer writes it
+            alignas(cacheLineSize) std::atomic<std::size_t> tail_; // only the producer writes it
+            std::atomic_bool isAbandoned_;
+        }; // END of class RecordRing
     } // END of namespace detail
 
     enum class LogLevel {
@@ -68,46 +100,180 @@ namespace logging {
         Debug,
     }; // END of enum class LogLevel
 
+    static auto constexpr levelCeiling = static_cast<LogLevel>(LOG_LEVEL_CEILING);
+
+    namespace detail {
+        inline std::atomic<LogLevel> currentLevel{ LogLevel::Debug }; // outside of Logger, so checking it doesn't construct the logger
+
+        // what a LogScope has to do, packed into one word so that a scope only ever loads one atomic
+        static unsigned constexpr scopeTraceFlag = 1U; // write the "Entering"/"Exiting" records; follows the log level
+        static unsigned constexpr scopeProfileFlag = 2U; // time the scope for the profiler
+        static unsigned constexpr scopeCaptureFlag = 4U; // also keep every call for the trace file
+        inline std::atomic<unsigned> scopeFlags{ LOG_LEVEL_CEILING >= 2 ? scopeTraceFlag : 0U };
+    } // END of namespace detail
+
+    // a constant false above the ceiling, so the compiler drops the whole statement; otherwise a single relaxed load
+    inline bool isLevelEnabled(LogLevel level) {
+        return level <= levelCeiling && level <= detail::currentLevel.load(std::memory_order_relaxed);
+    }
+
+    enum class OverflowPolicy {
+        Block, // the logging thread waits for the flusher to make room
+        Drop // the record is thrown away and counted
+    }; // END of enum class OverflowPolicy
+
+    class Logger;
+
+    // one log record being put together on the logging thread's stack.
+    // it's handed to the backend as a whole when it's destroyed, at the end of the LOG_ statement;
+    // whatever doesn't fit into capacity bytes is cut off.
+    class Record final {
+    public:
+        using this_type = Record;
+        static std::size_t constexpr capacity = 1024U;
+
+        explicit Record(Logger &logger);
+        Record(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+        ~Record();
+
+        template <class Type>
+        this_type &operator<<(Type const &value) {
+            using T = std::decay_t<Type>;
+            if constexpr (std::is_same_v<T, char>) {
+                append(&value, 1U);
+            } else if constexpr (std::is_same_v<T, char const *> || std::is_same_v<T, char *>) {
+                append(std::string_view{ value });
+            } else if constexpr (std::is_convertible_v<T const &, std::string_view>) {
+                append(std::string_view{ value });
+            } else if constexpr (std::is_same_v<T, bool>) {
+                append(value ? "1" : "0", 1U); // what std::ostream would have written
+            } else if constexpr (std::is_integral_v<T>) {
+                std::array<char, 24U> digits{ };
+                auto const result = std::to_chars(digits.data(), digits.data() + digits.size(), value);
+                append(digits.data(), static_cast<std::size_t>(result.ptr - digits.data()));
+            } else if constexpr (std::is_floating_point_v<T>) {
+                std::array<char, 32U> digits{ };
+                auto const length = std::snprintf(digits.data(), digits.size(), "%g", static_cast<double>(value));
+                append(digits.data(), static_cast<std::size_t>(length > 0 ? length : 0));
+            } else { // anything else is only ever logged off the hot path
+                std::ostringstream stream{ };
+                stream << value;
+                append(stream.str());
+            }
+            return *this;
+        }
+
+    private:
+        void append(std::string_view text);
+        void append(char const *text, std::size_t size);
+
+        Logger &logger_;
+        std::size_t size_;
+        std::array<char, capacity> text_;
+    }; // END of class Record
+
+    // the logging threads format their records themselves and append them to a ring of their own without taking a lock;
+    // a background thread collects the rings and writes to the file in large chunks.
     class Logger final {
     public:
         using this_type = Logger;
-        using value_type = detail::ThreadSafeOfStreamWrapper;
+        using value_type = Record;
         static std::string const file_;
         static std::ios::openmode const openMode_;
         static std::chrono::time_point<std::chrono::steady_clock> const baseTimestamp_;
+        static std::size_t constexpr ringCapacity = 64U * 1024U; // bytes, per logging thread
+        static std::chrono::milliseconds constexpr flushInterval{ 50 };
 
         Logger(this_type const &) = delete;
         Logger(this_type &&) = delete;
         this_type &operator=(this_type const &) = delete;
         this_type &operator=(this_type &&) = delete;
+        ~Logger();
 
         static this_type &getLogger();
 
-        value_type &log();
+        value_type log();
 
         void setLogLevel(LogLevel logLevel);
 
         LogLevel getLogLevel() const;
 
+        void setOverflowPolicy(OverflowPolicy overflowPolicy);
+
+        OverflowPolicy getOverflowPolicy() const;
+
+        std::size_t getDroppedCount() const; // the records thrown away under OverflowPolicy::Drop
+
+        void flush(); // blocks until everything the calling thread has logged so far is in the file
+
     private:
+        friend class Record;
+        using Mutex = std::mutex;
+        using Lock = std::unique_lock<Mutex>;
+
         Logger();
 
-        LogLevel level_;
-        value_type logfile_;
+        void submit(char const *text, std::size_t size);
+        detail::RecordRing &ringForCurrentThread();
+        void flusherThreadFunction();
+        void drainRings(std::string &batch);
+
+        std::atomic<OverflowPolicy> overflowPolicy_;
+        std::atomic<std::size_t> droppedCount_;
+        std::ofstream logfile_; // only the flusher touches it after construction
+        Mutex ringsMutex_; // taken once per thread to register its ring, and by the flusher
+        std::vector<std::shared_ptr<detail::RecordRing>> rings_;
+        Mutex wakeUpMutex_;
+        std::condition_variable wakeUp_;
+        std::condition_variable flushed_;
+        std::uint64_t flushRequests_;
+        std::uint64_t flushesDone_;
+        bool isStopping_;
+        std::thread flusher_; // last, so that it starts once everything above is set up
     }; // END of class Logger
 
+    // where a LOG_SCOPE is. there is one per LOG_SCOPE, initialized at compile time, so its address identifies the function.
+    struct ScopeSite final {
+        constexpr ScopeSite(char const *functionName, char const *fileName, int lineNumber) noexcept
+            : function{ functionName }, file{ fileName }, line{ lineNumber }, index{ -1 } { }
+
+        char const *function;
+        char const *file;
+        int line;
+        mutable std::atomic<int> index; // the profiler's number for this site; -1 until it first shows up there
+    }; // END of struct ScopeSite
+
+    // traces entering and leaving a function and times it for the profiler.
+    // when neither is switched on this is a single relaxed load; nothing is formatted, timed or allocated.
     class LogScope final {
     public:
         using this_type = LogScope;
-        using value_type = std::string;
+        using value_type = ScopeSite;
+
+        explicit LogScope(value_type const &site) noexcept
+            : site_{ site }, flags_{ detail::scopeFlags.load(std::memory_order_relaxed) }, start_{ 0U } {
+            if (flags_ != 0U) {
+                enter();
+            }
+        }
 
-        explicit LogScope(value_type val) noexcept;
+        LogScope(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
 
-        ~LogScope();
+        ~LogScope() {
+            if (flags_ != 0U) { // the flags that were set on the way in, so the pairs always match
+                exit();
+            }
+        }
 
     private:
-        value_type func_;
-        Logger &logger_;
+        void enter();
+        void exit() const;
+
+        value_type const &site_;
+        unsigned flags_;
+        std::uint64_t start_; // nanoseconds since Logger::baseTimestamp_; only set when profiling
     }; // END of class LogScope
 
 } // END of namespace logging
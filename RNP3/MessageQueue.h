@@ -1,56 +1,507 @@
 #pragma once
-#include <queue>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
 
 namespace utils {
-    template <class ValueType>
+    enum class QueueKind {
+        locking, // a mutex and two condition variables; can be unbounded
+        lockFree // a bounded MPMC ring of sequenced cells; blocking operations spin a little, then sleep until woken up
+    }; // END of enum class QueueKind
+
+    static auto constexpr unboundedCapacity = std::numeric_limits<std::size_t>::max();
+
+    // a multi producer, multi consumer queue.
+    // push blocks while the queue is full (backpressure), pop blocks while it's empty;
+    // close() wakes everyone up: pushes fail from then on, pops drain what's left and then return std::nullopt.
+    template <class ValueType, QueueKind Kind = QueueKind::locking>
     class ThreadSafeQueue final {
     public:
         using this_type = ThreadSafeQueue;
         using value_type = ValueType;
-        using container_type = std::queue<value_type>;
+        using container_type = std::deque<value_type>;
         using mutex_type = std::mutex;
         using lock_type = std::unique_lock<mutex_type>;
 
-        value_type pop(); // returns the 'first' item; blocks if there are no elements until there is at least one
-        void push(value_type const &data); // add an element to the back
-        void push(value_type &&data);
-        bool isEmpty() const; // query the queue as to whether it is empty or not
+        explicit ThreadSafeQueue(std::size_t capacity = unboundedCapacity);
+        ThreadSafeQueue(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+        bool push(value_type const &data); // blocks while full; false if the queue has been closed
+        bool push(value_type &&data);
+        bool tryPush(value_type &&data); // false if full or closed, data is left alone in that case
+        template <class InputIterator>
+        std::size_t pushBatch(InputIterator first, InputIterator last); // moves the elements in, taking the lock once per run of free slots
+        std::optional<value_type> pop(); // blocks while empty; std::nullopt once the queue is closed and drained
+        std::optional<value_type> tryPop();
+        template <class Rep, class Period>
+        std::optional<value_type> popFor(std::chrono::duration<Rep, Period> timeout);
+        template <class OutputIterator>
+        std::size_t popBatch(OutputIterator out, std::size_t maxCount); // blocks until there's at least one element, then takes up to maxCount
+        void close();
+        bool isClosed() const;
+        bool isEmpty() const;
+        std::size_t size() const;
+        std::size_t capacity() const;
 
     private:
-        container_type cont_; // the underlying std::queue container
-        mutable mutex_type mu_; // mutext to synchronize access
-        std::condition_variable cvHasMsgs_; // condvar to wake up threads sleeping on it
+        template <class Value>
+        bool pushImpl(Value &&data);
+        value_type takeFront(); // mu_ has to be held and cont_ mustn't be empty
+
+        container_type cont_;
+        std::size_t const capacity_;
+        bool isClosed_;
+        mutable mutex_type mu_;
+        std::condition_variable cvHasMsgs_; // consumers sleep on this one
+        std::condition_variable cvHasRoom_; // producers of a full queue sleep on this one
     }; // END of class ThreadSafeQueue
 
     template <class ValueType>
-    typename ThreadSafeQueue<ValueType>::value_type ThreadSafeQueue<ValueType>::pop() { // remove and retrieve
+    class ThreadSafeQueue<ValueType, QueueKind::lockFree> final {
+    public:
+        using this_type = ThreadSafeQueue;
+        using value_type = ValueType;
+
+        explicit ThreadSafeQueue(std::size_t capacity); // rounded up to the next power of two
+        ThreadSafeQueue(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+        bool push(value_type const &data);
+        bool push(value_type &&data);
+        bool tryPush(value_type &&data);
+        template <class InputIterator>
+        std::size_t pushBatch(InputIterator first, InputIterator last);
+        std::optional<value_type> pop();
+        std::optional<value_type> tryPop();
+        template <class Rep, class Period>
+        std::optional<value_type> popFor(std::chrono::duration<Rep, Period> timeout);
+        template <class OutputIterator>
+        std::size_t popBatch(OutputIterator out, std::size_t maxCount);
+        void close();
+        bool isClosed() const;
+        bool isEmpty() const;
+        std::size_t size() const; // a snapshot
+        std::size_t capacity() const;
+
+    private:
+        static std::size_t constexpr cacheLineSize = 64U;
+        static int constexpr spinLimit = 64; // yields before a blocking operation goes to sleep
+        using Clock = std::chrono::steady_clock;
+
+        struct Cell final {
+            using this_type = Cell;
+            std::atomic<std::size_t> sequence; // tells producers and consumers whose turn it is for this cell
+            std::optional<value_type> value;
+        }; // END of struct Cell
+
+        static std::size_t roundUpToPowerOfTwo(std::size_t value);
+        template <class Predicate>
+        bool waitUntil(Predicate isReady, std::optional<Clock::time_point> deadline); // isReady() once it returns
+        void wakeSleepers(); // after every push and pop, so nobody sleeps through what they were waiting for
+
+        std::unique_ptr<Cell[]> cells_;
+        std::size_t const mask_;
+        std::atomic_bool isClosed_;
+        alignas(cacheLineSize) std::atomic<std::size_t> enqueuePos_;
+        alignas(cacheLineSize) std::atomic<std::size_t> dequeuePos_;
+        alignas(cacheLineSize) std::atomic<int> sleepers_; // the fast paths only take sleepMutex_ if this isn't 0
+        std::mutex sleepMutex_;
+        std::condition_variable sleepCv_; // producers of a full and consumers of an empty queue both sleep on this one
+    }; // END of class ThreadSafeQueue<ValueType, QueueKind::lockFree>
+
+    template <class ValueType, QueueKind Kind>
+    ThreadSafeQueue<ValueType, Kind>::ThreadSafeQueue(std::size_t capacity)
+        : cont_{ }, capacity_{ capacity == 0U ? 1U : capacity }, isClosed_{ false } {
+    }
+
+    template <class ValueType, QueueKind Kind>
+    bool ThreadSafeQueue<ValueType, Kind>::push(value_type const &data) {
+        return pushImpl(data);
+    }
+
+    template <class ValueType, QueueKind Kind>
+    bool ThreadSafeQueue<ValueType, Kind>::push(value_type &&data) {
+        return pushImpl(std::move(data));
+    }
+
+    template <class ValueType, QueueKind Kind>
+    template <class Value>
+    bool ThreadSafeQueue<ValueType, Kind>::pushImpl(Value &&data) {
+        lock_type lock{ mu_ };
+        cvHasRoom_.wait(lock, [this] { // backpressure: wait for a consumer to make room
+            return isClosed_ || cont_.size() < capacity_;
+        });
+        if (isClosed_) {
+            return false;
+        }
+        cont_.push_back(std::forward<Value>(data));
+        lock.unlock();
+        cvHasMsgs_.notify_one(); // one element can only ever be taken by one consumer
+        return true;
+    }
+
+    template <class ValueType, QueueKind Kind>
+    bool ThreadSafeQueue<ValueType, Kind>::tryPush(value_type &&data) {
+        {
+            lock_type lock{ mu_ };
+            if (isClosed_ || cont_.size() >= capacity_) {
+                return false;
+            }
+            cont_.push_back(std::move(data));
+        }
+        cvHasMsgs_.notify_one();
+        return true;
+    }
+
+    template <class ValueType, QueueKind Kind>
+    template <class InputIterator>
+    std::size_t ThreadSafeQueue<ValueType, Kind>::pushBatch(InputIterator first, InputIterator last) {
+        std::size_t amtPushed = 0U;
+        while (first != last) {
+            lock_type lock{ mu_ };
+            cvHasRoom_.wait(lock, [this] {
+                return isClosed_ || cont_.size() < capacity_;
+            });
+            if (isClosed_) {
+                return amtPushed;
+            }
+            std::size_t amtThisRun = 0U;
+            for (; first != last && cont_.size() < capacity_; ++first, ++amtThisRun) {
+                cont_.push_back(std::move(*first));
+            }
+            lock.unlock();
+            amtPushed += amtThisRun;
+            if (amtThisRun == 1U) {
+                cvHasMsgs_.notify_one();
+            } else {
+                cvHasMsgs_.notify_all(); // there's something for everyone who's waiting
+            }
+        }
+        return amtPushed;
+    }
+
+    template <class ValueType, QueueKind Kind>
+    std::optional<typename ThreadSafeQueue<ValueType, Kind>::value_type> ThreadSafeQueue<ValueType, Kind>::pop() {
         lock_type lock{ mu_ };
         cvHasMsgs_.wait(lock, [this] { // wait until the container is no longer empty
-            return !cont_.empty(); // will happen instantly if it has elements
+            return isClosed_ || !cont_.empty(); // will happen instantly if it has elements
         });
-        auto retMe = cont_.front(); // get the first element
-        cont_.pop(); // remove it from the queue
-        return retMe;
+        if (cont_.empty()) {
+            return std::nullopt; // closed and drained
+        }
+        return takeFront();
     }
 
-    template <class ValueType>
-    void ThreadSafeQueue<ValueType>::push(value_type const &data) {
+    template <class ValueType, QueueKind Kind>
+    std::optional<typename ThreadSafeQueue<ValueType, Kind>::value_type> ThreadSafeQueue<ValueType, Kind>::tryPop() {
         lock_type lock{ mu_ };
-        cont_.push(data); // add the element to the back
-        cvHasMsgs_.notify_all(); // wake up the threads waiting for an item to show up in pop()
+        if (cont_.empty()) {
+            return std::nullopt;
+        }
+        return takeFront();
     }
 
-    template <class ValueType>
-    void ThreadSafeQueue<ValueType>::push(value_type &&data) {
+    template <class ValueType, QueueKind Kind>
+    template <class Rep, class Period>
+    std::optional<typename ThreadSafeQueue<ValueType, Kind>::value_type> ThreadSafeQueue<ValueType, Kind>::popFor(std::chrono::duration<Rep, Period> timeout) {
         lock_type lock{ mu_ };
-        cont_.push(std::move(data));
+        auto const isReady = cvHasMsgs_.wait_for(lock, timeout, [this] {
+            return isClosed_ || !cont_.empty();
+        });
+        if (!isReady || cont_.empty()) {
+            return std::nullopt;
+        }
+        return takeFront();
+    }
+
+    template <class ValueType, QueueKind Kind>
+    template <class OutputIterator>
+    std::size_t ThreadSafeQueue<ValueType, Kind>::popBatch(OutputIterator out, std::size_t maxCount) {
+        std::size_t amtPopped = 0U;
+        {
+            lock_type lock{ mu_ };
+            cvHasMsgs_.wait(lock, [this] {
+                return isClosed_ || !cont_.empty();
+            });
+            for (; amtPopped < maxCount && !cont_.empty(); ++amtPopped) {
+                *out++ = std::move(cont_.front());
+                cont_.pop_front();
+            }
+        }
+        if (amtPopped != 0U) {
+            cvHasRoom_.notify_all();
+        }
+        return amtPopped;
+    }
+
+    template <class ValueType, QueueKind Kind>
+    typename ThreadSafeQueue<ValueType, Kind>::value_type ThreadSafeQueue<ValueType, Kind>::takeFront() {
+        auto retMe = std::move(cont_.front()); // move the first element out rather than copying it
+        cont_.pop_front();
+        if (capacity_ != unboundedCapacity) {
+            cvHasRoom_.notify_one(); // notifying with the lock held is fine, the woken producer just has to wait for it
+        }
+        return retMe;
+    }
+
+    template <class ValueType, QueueKind Kind>
+    void ThreadSafeQueue<ValueType, Kind>::close() {
+        {
+            lock_type lock{ mu_ };
+            isClosed_ = true;
+        }
         cvHasMsgs_.notify_all();
+        cvHasRoom_.notify_all();
     }
 
-    template <class ValueType>
-    bool ThreadSafeQueue<ValueType>::isEmpty() const {
+    template <class ValueType, QueueKind Kind>
+    bool ThreadSafeQueue<ValueType, Kind>::isClosed() const {
+        lock_type lock{ mu_ };
+        return isClosed_;
+    }
+
+    template <class ValueType, QueueKind Kind>
+    bool ThreadSafeQueue<ValueType, Kind>::isEmpty() const {
         lock_type lock{ mu_ };
         return cont_.empty();
     }
+
+    template <class ValueType, QueueKind Kind>
+    std::size_t ThreadSafeQueue<ValueType, Kind>::size() const {
+        lock_type lock{ mu_ };
+        return cont_.size();
+    }
+
+    template <class ValueType, QueueKind Kind>
+    std::size_t ThreadSafeQueue<ValueType, Kind>::capacity() const {
+        return capacity_;
+    }
+
+    template <class ValueType>
+    ThreadSafeQueue<ValueType, QueueKind::lockFree>::ThreadSafeQueue(std::size_t capacity)
+        : cells_{ std::make_unique<Cell[]>(roundUpToPowerOfTwo(capacity)) },
+          mask_{ roundUpToPowerOfTwo(capacity) - 1U }, isClosed_{ false }, enqueuePos_{ 0U }, dequeuePos_{ 0U },
+          sleepers_{ 0 }, sleepMutex_{ }, sleepCv_{ } {
+        for (std::size_t i = 0U; i <= mask_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    template <class ValueType>
+    bool ThreadSafeQueue<ValueType, QueueKind::lockFree>::push(value_type const &data) {
+        auto copy = data;
+        return push(std::move(copy));
+    }
+
+    template <class ValueType>
+    bool ThreadSafeQueue<ValueType, QueueKind::lockFree>::push(value_type &&data) {
+        while (!tryPush(std::move(data))) { // tryPush only moves from data when it succeeds
+            if (isClosed()) {
+                return false;
+            }
+            waitUntil([this] {
+                return isClosed() || size() < capacity();
+            }, std::nullopt);
+        }
+        return true;
+    }
+
+    template <class ValueType>
+    bool ThreadSafeQueue<ValueType, QueueKind::lockFree>::tryPush(value_type &&data) {
+        if (isClosed()) {
+            return false;
+        }
+
+        auto pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            auto const sequence = cell->sequence.load(std::memory_order_acquire);
+            auto const difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+            if (difference == 0) { // the cell is free; claim it
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1U, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) { // the cell still holds the element from one lap ago: full
+                return false;
+            } else { // another producer got there first
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value.emplace(std::move(data));
+        cell->sequence.store(pos + 1U, std::memory_order_release); // hands the cell to the consumers
+        wakeSleepers();
+        return true;
+    }
+
+    template <class ValueType>
+    template <class InputIterator>
+    std::size_t ThreadSafeQueue<ValueType, QueueKind::lockFree>::pushBatch(InputIterator first, InputIterator last) {
+        std::size_t amtPushed = 0U;
+        for (; first != last; ++first, ++amtPushed) {
+            if (!push(std::move(*first))) {
+                break;
+            }
+        }
+        return amtPushed;
+    }
+
+    template <class ValueType>
+    std::optional<typename ThreadSafeQueue<ValueType, QueueKind::lockFree>::value_type> ThreadSafeQueue<ValueType, QueueKind::lockFree>::pop() {
+        for (;;) {
+            if (auto value = tryPop()) {
+                return value;
+            }
+            if (isClosed()) {
+                return tryPop(); // something may have slipped in right before the close
+            }
+            waitUntil([this] {
+                return isClosed() || !isEmpty();
+            }, std::nullopt);
+        }
+    }
+
+    template <class ValueType>
+    std::optional<typename ThreadSafeQueue<ValueType, QueueKind::lockFree>::value_type> ThreadSafeQueue<ValueType, QueueKind::lockFree>::tryPop() {
+        auto pos = dequeuePos_.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            auto const sequence = cell->sequence.load(std::memory_order_acquire);
+            auto const difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos + 1U);
+            if (difference == 0) { // the cell has been filled; claim it
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1U, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) { // nothing has been pushed into the cell yet: empty
+                return std::nullopt;
+            } else { // another consumer got there first
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        auto value = std::move(cell->value);
+        cell->value.reset();
+        cell->sequence.store(pos + mask_ + 1U, std::memory_order_release); // hands the cell to the producers of the next lap
+        wakeSleepers();
+        return value;
+    }
+
+    template <class ValueType>
+    template <class Rep, class Period>
+    std::optional<typename ThreadSafeQueue<ValueType, QueueKind::lockFree>::value_type> ThreadSafeQueue<ValueType, QueueKind::lockFree>::popFor(std::chrono::duration<Rep, Period> timeout) {
+        auto const deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(timeout);
+        for (;;) {
+            if (auto value = tryPop()) {
+                return value;
+            }
+            if (isClosed()) {
+                return tryPop(); // something may have slipped in right before the close
+            }
+            if (!waitUntil([this] { return isClosed() || !isEmpty(); }, deadline)) {
+                return std::nullopt;
+            }
+        }
+    }
+
+    template <class ValueType>
+    template <class OutputIterator>
+    std::size_t ThreadSafeQueue<ValueType, QueueKind::lockFree>::popBatch(OutputIterator out, std::size_t maxCount) {
+        if (maxCount == 0U) {
+            return 0U;
+        }
+        auto first = pop();
+        if (!first) {
+            return 0U;
+        }
+        *out++ = std::move(*first);
+        std::size_t amtPopped = 1U;
+        for (; amtPopped < maxCount; ++amtPopped) {
+            auto value = tryPop();
+            if (!value) {
+                break;
+            }
+            *out++ = std::move(*value);
+        }
+        return amtPopped;
+    }
+
+    template <class ValueType>
+    void ThreadSafeQueue<ValueType, QueueKind::lockFree>::close() {
+        isClosed_.store(true, std::memory_order_release);
+        wakeSleepers();
+    }
+
+    template <class ValueType>
+    bool ThreadSafeQueue<ValueType, QueueKind::lockFree>::isClosed() const {
+        return isClosed_.load(std::memory_order_acquire);
+    }
+
+    template <class ValueType>
+    bool ThreadSafeQueue<ValueType, QueueKind::lockFree>::isEmpty() const {
+        return size() == 0U;
+    }
+
+    template <class ValueType>
+    std::size_t ThreadSafeQueue<ValueType, QueueKind::lockFree>::size() const {
+        auto const dequeuePos = dequeuePos_.load(std::memory_order_acquire);
+        auto const enqueuePos = enqueuePos_.load(std::memory_order_acquire);
+        return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0U;
+    }
+
+    template <class ValueType>
+    std::size_t ThreadSafeQueue<ValueType, QueueKind::lockFree>::capacity() const {
+        return mask_ + 1U;
+    }
+
+    template <class ValueType>
+    std::size_t ThreadSafeQueue<ValueType, QueueKind::lockFree>::roundUpToPowerOfTwo(std::size_t value) {
+        std::size_t result = 1U;
+        while (result < value) {
+            result <<= 1U;
+        }
+        return result;
+    }
+
+    template <class ValueType>
+    template <class Predicate>
+    bool ThreadSafeQueue<ValueType, QueueKind::lockFree>::waitUntil(Predicate isReady, std::optional<Clock::time_point> deadline) {
+        for (auto i = 0; i < spinLimit; ++i) { // whatever we're waiting for is usually only a moment away
+            if (isReady()) {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lock{ sleepMutex_ };
+        sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst); // isReady sees the push or pop of anyone who didn't see us
+        auto isWokenUp = true;
+        if (deadline) {
+            isWokenUp = sleepCv_.wait_until(lock, *deadline, isReady);
+        } else {
+            sleepCv_.wait(lock, isReady);
+        }
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        return isWokenUp;
+    }
+
+    template <class ValueType>
+    void ThreadSafeQueue<ValueType, QueueKind::lockFree>::wakeSleepers() {
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the one in waitUntil
+        if (sleepers_.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock{ sleepMutex_ }; // a sleeper that has checked isReady is in wait by now
+        }
+        sleepCv_.notify_all();
+    }
 } // END of namespace utils
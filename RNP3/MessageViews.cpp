@@ -0,0 +1,218 @@
+#include "MessageViews.h"
+#include <utility>
+#include "WireFormat.h"
+#include "Logger.h"
+
+namespace utils {
+    ReqLoginView::ReqLoginView(Frame frame)
+        : frame_{ std::move(frame) } {
+        LOG_SCOPE;
+    }
+
+    Frame const &ReqLoginView::getFrame() const {
+        LOG_SCOPE;
+        return frame_;
+    }
+
+    std::string_view ReqLoginView::getUsername() const {
+        LOG_SCOPE;
+        return std::string_view{ frame_.body(), frame_.getLength() };
+    }
+
+    UsernameRecordView::UsernameRecordView(char const *begin)
+        : begin_{ begin } {
+        LOG_SCOPE;
+    }
+
+    Word UsernameRecordView::getIp() const {
+        LOG_SCOPE;
+        return wire::UsernameRecord::load<wire::UsernameRecord::ip>(begin_);
+    }
+
+    HalfWord UsernameRecordView::getPort() const {
+        LOG_SCOPE;
+        return wire::UsernameRecord::load<wire::UsernameRecord::port>(begin_);
+    }
+
+    Byte UsernameRecordView::getLengthUsername() const {
+        LOG_SCOPE;
+        return wire::UsernameRecord::load<wire::UsernameRecord::lengthUsername>(begin_);
+    }
+
+    std::string_view UsernameRecordView::getUsername() const {
+        LOG_SCOPE;
+        return std::string_view{ begin_ + usernameRecordStaticByteSize, getLengthUsername() };
+    }
+
+    std::size_t UsernameRecordView::byteSize() const {
+        LOG_SCOPE;
+        return usernameRecordStaticByteSize + paddedUsernameLength(getLengthUsername());
+    }
+
+    UpdateClientListView::const_iterator::const_iterator(char const *position)
+        : position_{ position } {
+        LOG_SCOPE;
+    }
+
+    UpdateClientListView::const_iterator::reference UpdateClientListView::const_iterator::operator*() const {
+        LOG_SCOPE;
+        return UsernameRecordView{ position_ };
+    }
+
+    UpdateClientListView::const_iterator::this_type &UpdateClientListView::const_iterator::operator++() {
+        LOG_SCOPE;
+        position_ += UsernameRecordView{ position_ }.byteSize();
+        return *this;
+    }
+
+    UpdateClientListView::const_iterator::this_type UpdateClientListView::const_iterator::operator++(int) {
+        LOG_SCOPE;
+        auto copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    UpdateClientListView::UpdateClientListView(Frame frame)
+        : frame_{ std::move(frame) } {
+        LOG_SCOPE;
+    }
+
+    Frame const &UpdateClientListView::getFrame() const {
+        LOG_SCOPE;
+        return frame_;
+    }
+
+    Word UpdateClientListView::size() const {
+        LOG_SCOPE;
+        return frame_.getLength();
+    }
+
+    UpdateClientListView::const_iterator UpdateClientListView::begin() const {
+        LOG_SCOPE;
+        return cbegin();
+    }
+
+    UpdateClientListView::const_iterator UpdateClientListView::cbegin() const {
+        LOG_SCOPE;
+        return const_iterator{ frame_.body() };
+    }
+
+    UpdateClientListView::const_iterator UpdateClientListView::end() const {
+        LOG_SCOPE;
+        return cend();
+    }
+
+    UpdateClientListView::const_iterator UpdateClientListView::cend() const {
+        LOG_SCOPE;
+        return const_iterator{ frame_.data() + frame_.size() }; // the records fill the frame up to its end
+    }
+
+    UpdateClientListDeltaView::UpdateClientListDeltaView(Frame frame)
+        : frame_{ std::move(frame) } {
+        LOG_SCOPE;
+    }
+
+    Frame const &UpdateClientListDeltaView::getFrame() const {
+        LOG_SCOPE;
+        return frame_;
+    }
+
+    Word UpdateClientListDeltaView::getBaseVersion() const {
+        LOG_SCOPE;
+        return wire::ClientListDelta::load<wire::ClientListDelta::baseVersion>(frame_.body());
+    }
+
+    Word UpdateClientListDeltaView::getRosterVersion() const {
+        LOG_SCOPE;
+        return wire::ClientListDelta::load<wire::ClientListDelta::rosterVersion>(frame_.body());
+    }
+
+    bool UpdateClientListDeltaView::isFullRoster() const {
+        LOG_SCOPE;
+        return getBaseVersion() == UpdateClientListDeltaMessage::fullRoster;
+    }
+
+    Word UpdateClientListDeltaView::getAmtAdded() const {
+        LOG_SCOPE;
+        return wire::ClientListDelta::load<wire::ClientListDelta::amtAdded>(frame_.body());
+    }
+
+    Word UpdateClientListDeltaView::getAmtRemoved() const {
+        LOG_SCOPE;
+        return frame_.getLength() - getAmtAdded();
+    }
+
+    UpdateClientListDeltaView::const_iterator UpdateClientListDeltaView::addedBegin() const {
+        LOG_SCOPE;
+        return const_iterator{ frame_.body() + clientListDeltaStaticByteSize };
+    }
+
+    UpdateClientListDeltaView::const_iterator UpdateClientListDeltaView::addedEnd() const {
+        LOG_SCOPE;
+        auto it = addedBegin();
+        for (auto i = getAmtAdded(); i > 0U; --i) {
+            ++it;
+        }
+        return it;
+    }
+
+    UpdateClientListDeltaView::const_iterator UpdateClientListDeltaView::removedBegin() const {
+        LOG_SCOPE;
+        return addedEnd();
+    }
+
+    UpdateClientListDeltaView::const_iterator UpdateClientListDeltaView::removedEnd() const {
+        LOG_SCOPE;
+        return const_iterator{ frame_.data() + frame_.size() };
+    }
+
+    SendMessageView::SendMessageView(Frame frame)
+        : frame_{ std::move(frame) } {
+        LOG_SCOPE;
+    }
+
+    Frame const &SendMessageView::getFrame() const {
+        LOG_SCOPE;
+        return frame_;
+    }
+
+    Word SendMessageView::getMessageId() const {
+        LOG_SCOPE;
+        return wire::SendMsgStruct::load<wire::SendMsgStruct::messageId>(frame_.body());
+    }
+
+    Word SendMessageView::getSourceIp() const {
+        LOG_SCOPE;
+        return wire::SendMsgStruct::load<wire::SendMsgStruct::sourceIp>(frame_.body());
+    }
+
+    Word SendMessageView::getTargetIp() const {
+        LOG_SCOPE;
+        return wire::SendMsgStruct::load<wire::SendMsgStruct::targetIp>(frame_.body());
+    }
+
+    HalfWord SendMessageView::getSourcePort() const {
+        LOG_SCOPE;
+        return wire::SendMsgStruct::load<wire::SendMsgStruct::sourcePort>(frame_.body());
+    }
+
+    HalfWord SendMessageView::getTargetPort() const {
+        LOG_SCOPE;
+        return wire::SendMsgStruct::load<wire::SendMsgStruct::targetPort>(frame_.body());
+    }
+
+    std::string_view SendMessageView::getText() const {
+        LOG_SCOPE;
+        return std::string_view{ frame_.body() + sendMsgStructByteSize, frame_.getLength() - sendMsgStructByteSize };
+    }
+
+    std::string_view SendMsgGrpView::getMessageText() const {
+        LOG_SCOPE;
+        return getText();
+    }
+
+    std::string_view SendMsgUsrView::getMessageText() const {
+        LOG_SCOPE;
+        return getText();
+    }
+} // END of namespace utils
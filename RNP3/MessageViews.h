@@ -0,0 +1,207 @@
+#pragma once
+#include "Types.h"
+#include "Frame.h"
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <iterator>
+#include <string_view>
+
+namespace utils {
+    // the views decode their fields straight out of the frame they hold on to;
+    // none of the accessors allocate, the string_views point into the receive buffer.
+
+    template <class MessageT>
+    class HeaderOnlyView final { // for the messages that are nothing but the common header
+    public:
+        using this_type = HeaderOnlyView;
+        using message_type = MessageT;
+
+        explicit HeaderOnlyView(Frame frame) : frame_{ std::move(frame) } { }
+        Frame const &getFrame() const { return frame_; }
+
+    private:
+        Frame frame_;
+    }; // END of class HeaderOnlyView
+
+    using ReqFindServerView = HeaderOnlyView<ReqFindServerMessage>;
+    using ResFindServerView = HeaderOnlyView<ResFindServerMessage>;
+    using ReqHeartbeatView = HeaderOnlyView<ReqHeartbeatMessage>;
+    using ResHeartbeatView = HeaderOnlyView<ResHeartbeatMessage>;
+    using ReqClientListView = HeaderOnlyView<ReqClientListMessage>;
+
+    class ReqLoginView final {
+    public:
+        using this_type = ReqLoginView;
+
+        explicit ReqLoginView(Frame frame);
+        Frame const &getFrame() const;
+        std::string_view getUsername() const;
+
+    private:
+        Frame frame_;
+    }; // END of class ReqLoginView
+
+    class UsernameRecordView final {
+    public:
+        using this_type = UsernameRecordView;
+
+        explicit UsernameRecordView(char const *begin); // begin has to point into a frame that outlives the view
+        Word getIp() const;
+        HalfWord getPort() const;
+        Byte getLengthUsername() const;
+        std::string_view getUsername() const;
+        std::size_t byteSize() const; // the amount of bytes the record takes up on the wire, padding included
+
+    private:
+        char const *begin_;
+    }; // END of class UsernameRecordView
+
+    class UpdateClientListView final {
+    public:
+        using this_type = UpdateClientListView;
+        using value_type = UsernameRecordView;
+
+        class const_iterator final {
+        public:
+            using this_type = const_iterator;
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = UsernameRecordView;
+            using difference_type = std::ptrdiff_t;
+            using pointer = value_type const *;
+            using reference = value_type;
+
+            explicit const_iterator(char const *position);
+            reference operator*() const;
+            this_type &operator++();
+            this_type operator++(int);
+            friend bool operator==(this_type const &lhs, this_type const &rhs) { return lhs.position_ == rhs.position_; }
+            friend bool operator!=(this_type const &lhs, this_type const &rhs) { return !(lhs == rhs); }
+
+        private:
+            char const *position_;
+        }; // END of class const_iterator
+
+        explicit UpdateClientListView(Frame frame);
+        Frame const &getFrame() const;
+        Word size() const; // the amount of records
+        const_iterator begin() const;
+        const_iterator cbegin() const;
+        const_iterator end() const;
+        const_iterator cend() const;
+
+    private:
+        Frame frame_;
+    }; // END of class UpdateClientListView
+
+    class UpdateClientListDeltaView final {
+    public:
+        using this_type = UpdateClientListDeltaView;
+        using value_type = UsernameRecordView;
+        using const_iterator = UpdateClientListView::const_iterator;
+
+        explicit UpdateClientListDeltaView(Frame frame);
+        Frame const &getFrame() const;
+        Word getBaseVersion() const;
+        Word getRosterVersion() const;
+        bool isFullRoster() const;
+        Word getAmtAdded() const;
+        Word getAmtRemoved() const;
+        const_iterator addedBegin() const;
+        const_iterator addedEnd() const; // walks the added records, so it's linear in their amount
+        const_iterator removedBegin() const;
+        const_iterator removedEnd() const;
+
+    private:
+        Frame frame_;
+    }; // END of class UpdateClientListDeltaView
+
+    class SendMessageView {
+    public:
+        using this_type = SendMessageView;
+
+        explicit SendMessageView(Frame frame);
+        Frame const &getFrame() const;
+        Word getMessageId() const;
+        Word getSourceIp() const;
+        Word getTargetIp() const;
+        HalfWord getSourcePort() const;
+        HalfWord getTargetPort() const;
+
+    protected:
+        std::string_view getText() const;
+
+    private:
+        Frame frame_;
+    }; // END of class SendMessageView
+
+    class SendMsgGrpView final : public SendMessageView {
+    public:
+        using this_type = SendMsgGrpView;
+        using Base = SendMessageView;
+
+        using SendMessageView::SendMessageView;
+        std::string_view getMessageText() const;
+    }; // END of class SendMsgGrpView
+
+    class SendMsgUsrView final : public SendMessageView {
+    public:
+        using this_type = SendMsgUsrView;
+        using Base = SendMessageView;
+
+        using SendMessageView::SendMessageView;
+        std::string_view getMessageText() const;
+    }; // END of class SendMsgUsrView
+
+    class ErrorMsgNotDeliveredView final : public SendMessageView {
+    public:
+        using this_type = ErrorMsgNotDeliveredView;
+        using Base = SendMessageView;
+
+        using SendMessageView::SendMessageView;
+    }; // END of class ErrorMsgNotDeliveredView
+
+    template <class MessageT>
+    struct view_for final { // the view that reads a MessageT straight out of a frame
+        using this_type = view_for;
+        using type = HeaderOnlyView<MessageT>;
+    }; // END of struct view_for
+
+    template <> struct view_for<ReqLoginMessage> final { using type = ReqLoginView; };
+    template <> struct view_for<UpdateClientListMessage> final { using type = UpdateClientListView; };
+    template <> struct view_for<UpdateClientListDeltaMessage> final { using type = UpdateClientListDeltaView; };
+    template <> struct view_for<SendMsgGrpMessage> final { using type = SendMsgGrpView; };
+    template <> struct view_for<SendMsgUsrMessage> final { using type = SendMsgUsrView; };
+    template <> struct view_for<ErrorMsgNotDeliveredMessage> final { using type = ErrorMsgNotDeliveredView; };
+
+    template <class MessageT>
+    using view_for_t = typename view_for<MessageT>::type;
+
+    namespace detail {
+        template <class MessageT, class Visitor>
+        void visitAs(Frame &&frame, Visitor &visitor) {
+            visitor(view_for_t<MessageT>{ std::move(frame) });
+        }
+
+        template <class Visitor, std::size_t... Indices>
+        constexpr auto makeVisitTable(std::index_sequence<Indices...>) {
+            using Function = void(*)(Frame &&, Visitor &);
+            return std::array<Function, sizeof...(Indices)>{ { &visitAs<type_at_t<Indices, MessageTypeList>, Visitor>... } };
+        }
+    } // END of namespace detail
+
+    // calls visitor with the view that matches the type of frame. the jump table is generated from MessageTypeList
+    // at compile time, so there's neither a switch nor a type lookup per frame.
+    template <class Visitor>
+    void visitFrame(Frame frame, Visitor &&visitor) {
+        using VisitorType = std::remove_reference_t<Visitor>;
+        static auto constexpr table = detail::makeVisitTable<VisitorType>(std::make_index_sequence<amtMessageTypes>{ });
+        auto const index = static_cast<std::size_t>(static_cast<std::underlying_type_t<MessageType>>(frame.getType())) - 1U;
+        if (index >= table.size()) {
+            throw std::logic_error{ "unrecognized MessageType in visitFrame" };
+        }
+        table[index](std::move(frame), visitor);
+    }
+} // END of namespace utils
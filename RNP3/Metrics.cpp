@@ -0,0 +1,285 @@
+#include "Metrics.h"
+#include <algorithm> // std::max
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include "Logger.h"
+
+namespace metrics {
+    namespace {
+        std::size_t stripeOfCurrentThread() {
+            thread_local auto const stripe = std::hash<std::thread::id>{ }(std::this_thread::get_id()) % Counter::amtStripes;
+            return stripe;
+        }
+
+        void writeSample(std::ostream &out, std::string const &name, std::string const &labels, std::string const &value) {
+            out << name;
+            if (!labels.empty()) {
+                out << '{' << labels << '}';
+            }
+            out << ' ' << value << '\n';
+        }
+
+        std::string joinLabels(std::string const &labels, std::string const &extra) {
+            return labels.empty() ? extra : labels + ',' + extra;
+        }
+    } // END of anonymous namespace
+
+    Counter::Counter() : stripes_{ } {
+        LOG_SCOPE;
+    }
+
+    void Counter::add(std::uint64_t amount) {
+        LOG_SCOPE;
+        stripes_[stripeOfCurrentThread()].value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    std::uint64_t Counter::get() const {
+        LOG_SCOPE;
+        std::uint64_t sum = 0U;
+        for (auto const &stripe : stripes_) {
+            sum += stripe.value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    Gauge::Gauge() : value_{ 0 } {
+        LOG_SCOPE;
+    }
+
+    void Gauge::set(std::int64_t value) {
+        LOG_SCOPE;
+        value_.store(value, std::memory_order_relaxed);
+    }
+
+    void Gauge::add(std::int64_t amount) {
+        LOG_SCOPE;
+        value_.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    std::int64_t Gauge::get() const {
+        LOG_SCOPE;
+        return value_.load(std::memory_order_relaxed);
+    }
+
+    Histogram::Histogram() : buckets_{ }, count_{ 0U }, sum_{ 0U }, max_{ 0U } {
+        LOG_SCOPE;
+    }
+
+    void Histogram::record(std::uint64_t value) {
+        LOG_SCOPE;
+        buckets_[bucketOf(value)].fetch_add(1U, std::memory_order_relaxed);
+        count_.fetch_add(1U, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        auto max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    std::uint64_t Histogram::getCount() const {
+        LOG_SCOPE;
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t Histogram::getSum() const {
+        LOG_SCOPE;
+        return sum_.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t Histogram::getMax() const {
+        LOG_SCOPE;
+        return max_.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t Histogram::getQuantile(double quantile) const {
+        LOG_SCOPE;
+        std::array<std::uint64_t, amtBuckets> snapshot{ };
+        std::uint64_t count = 0U;
+        for (std::size_t i = 0U; i < amtBuckets; ++i) { // count_ may be ahead of the buckets, so count them instead
+            snapshot[i] = buckets_[i].load(std::memory_order_relaxed);
+            count += snapshot[i];
+        }
+        if (count == 0U) {
+            return 0U;
+        }
+
+        auto const wanted = std::max<std::uint64_t>(1U, static_cast<std::uint64_t>(quantile * static_cast<double>(count) + 0.5));
+        std::uint64_t seen = 0U;
+        for (std::size_t i = 0U; i < amtBuckets; ++i) {
+            seen += snapshot[i];
+            if (seen >= wanted) {
+                return std::min(upperBoundOf(i), getMax());
+            }
+        }
+        return getMax();
+    }
+
+    // values below subBucketCount get a bucket each; above that, the position of the highest set bit picks the
+    // power of two and the subBucketBits bits below it pick the linear sub bucket
+    std::size_t Histogram::bucketOf(std::uint64_t value) {
+        LOG_SCOPE;
+        if (value < subBucketCount) {
+            return static_cast<std::size_t>(value);
+        }
+        std::size_t highestBit = 0U;
+        for (auto v = value; v > 1U; v >>= 1U) {
+            ++highestBit;
+        }
+        auto const shift = highestBit - subBucketBits;
+        auto const subBucket = static_cast<std::size_t>(value >> shift) - subBucketCount;
+        return (shift + 1U) * subBucketCount + subBucket;
+    }
+
+    std::uint64_t Histogram::upperBoundOf(std::size_t bucket) {
+        LOG_SCOPE;
+        if (bucket < subBucketCount) {
+            return bucket;
+        }
+        auto const shift = bucket / subBucketCount - 1U;
+        auto const subBucket = bucket % subBucketCount;
+        auto const lowerBound = static_cast<std::uint64_t>(subBucketCount + subBucket) << shift;
+        return lowerBound + ((static_cast<std::uint64_t>(1U) << shift) - 1U);
+    }
+
+    Registry::this_type &Registry::getRegistry() {
+        LOG_SCOPE;
+        static this_type instance{ };
+        return instance;
+    }
+
+    Registry::Registry() : mutex_{ }, families_{ }, collectors_{ }, nextCollectorId_{ 0U } {
+        LOG_SCOPE;
+    }
+
+    Registry::Family &Registry::family(std::string const &name, std::string const &help, Kind kind) {
+        LOG_SCOPE;
+        auto result = families_.try_emplace(name);
+        auto &family = result.first->second;
+        if (result.second) {
+            family.help = help;
+            family.kind = kind;
+        } else if (family.kind != kind) {
+            throw std::logic_error{ "metric " + name + " was registered with another kind before" };
+        }
+        return family;
+    }
+
+    Counter &Registry::counter(std::string const &name, std::string const &help, std::string const &labels) {
+        LOG_SCOPE;
+        Lock lock{ mutex_ };
+        auto &slot = family(name, help, Kind::Counter).counters[labels];
+        if (slot == nullptr) {
+            slot = std::make_unique<Counter>();
+        }
+        return *slot;
+    }
+
+    Gauge &Registry::gauge(std::string const &name, std::string const &help, std::string const &labels) {
+        LOG_SCOPE;
+        Lock lock{ mutex_ };
+        auto &slot = family(name, help, Kind::Gauge).gauges[labels];
+        if (slot == nullptr) {
+            slot = std::make_unique<Gauge>();
+        }
+        return *slot;
+    }
+
+    Histogram &Registry::histogram(std::string const &name, std::string const &help, std::string const &labels) {
+        LOG_SCOPE;
+        Lock lock{ mutex_ };
+        auto &slot = family(name, help, Kind::Histogram).histograms[labels];
+        if (slot == nullptr) {
+            slot = std::make_unique<Histogram>();
+        }
+        return *slot;
+    }
+
+    Registry::CollectorId Registry::addCollector(Collector collector) {
+        LOG_SCOPE;
+        Lock lock{ mutex_ };
+        auto const id = nextCollectorId_++;
+        collectors_.emplace(id, std::move(collector));
+        return id;
+    }
+
+    void Registry::removeCollector(CollectorId id) {
+        LOG_SCOPE;
+        Lock lock{ mutex_ };
+        collectors_.erase(id);
+    }
+
+    std::string Registry::render() const {
+        LOG_SCOPE;
+        static double constexpr quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+        std::ostringstream out{ };
+        Lock lock{ mutex_ };
+        for (auto const &pair : families_) {
+            auto const &name = pair.first;
+            auto const &family = pair.second;
+            out << "# HELP " << name << ' ' << family.help << '\n';
+            switch (family.kind) {
+                case Kind::Counter:
+                    out << "# TYPE " << name << " counter\n";
+                    for (auto const &counter : family.counters) {
+                        writeSample(out, name, counter.first, std::to_string(counter.second->get()));
+                    }
+                    break;
+                case Kind::Gauge:
+                    out << "# TYPE " << name << " gauge\n";
+                    for (auto const &gauge : family.gauges) {
+                        writeSample(out, name, gauge.first, std::to_string(gauge.second->get()));
+                    }
+                    break;
+                case Kind::Histogram: // quantiles computed here, so it's a summary as far as a scraper is concerned
+                    out << "# TYPE " << name << " summary\n";
+                    for (auto const &histogram : family.histograms) {
+                        auto const &labels = histogram.first;
+                        for (auto const quantile : quantiles) {
+                            std::ostringstream quantileLabel{ };
+                            quantileLabel << "quantile=\"" << quantile << '"';
+                            writeSample(out, name, joinLabels(labels, quantileLabel.str()),
+                                        std::to_string(histogram.second->getQuantile(quantile)));
+                        }
+                        writeSample(out, name + "_sum", labels, std::to_string(histogram.second->getSum()));
+                        writeSample(out, name + "_count", labels, std::to_string(histogram.second->getCount()));
+                    }
+                    break;
+            }
+        }
+
+        for (auto const &pair : collectors_) {
+            pair.second(out);
+        }
+
+        out << "# HELP rnp3_log_records_dropped_total Log records thrown away because a logging ring was full.\n"
+            << "# TYPE rnp3_log_records_dropped_total counter\n"
+            << "rnp3_log_records_dropped_total " << logging::Logger::getLogger().getDroppedCount() << '\n';
+        return out.str();
+    }
+
+    Counter &bytesReceived() {
+        LOG_SCOPE;
+        static auto &counter = Registry::getRegistry().counter("rnp3_bytes_received_total", "Bytes read from client sockets.");
+        return counter;
+    }
+
+    Counter &bytesSent() {
+        LOG_SCOPE;
+        static auto &counter = Registry::getRegistry().counter("rnp3_bytes_sent_total", "Bytes written to client sockets.");
+        return counter;
+    }
+
+    Counter &decodeFailures() {
+        LOG_SCOPE;
+        static auto &counter = Registry::getRegistry().counter("rnp3_decode_failures_total",
+                                                               "Frames that couldn't be decoded.");
+        return counter;
+    }
+
+    Gauge &activeConnections() {
+        LOG_SCOPE;
+        static auto &gauge = Registry::getRegistry().gauge("rnp3_active_connections", "Client connections currently open.");
+        return gauge;
+    }
+} // END of namespace metrics
@@ -0,0 +1,133 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace metrics {
+    // a monotonically increasing count. the value is striped over a few cache lines, so that the I/O threads
+    // don't fight over a single one; reading it sums the stripes up.
+    class Counter final {
+    public:
+        using this_type = Counter;
+        static std::size_t constexpr amtStripes = 8U;
+
+        Counter();
+        Counter(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+        void add(std::uint64_t amount = 1U);
+        std::uint64_t get() const;
+
+    private:
+        struct alignas(64) Stripe final {
+            std::atomic<std::uint64_t> value{ 0U };
+        }; // END of struct Stripe
+
+        std::array<Stripe, amtStripes> stripes_;
+    }; // END of class Counter
+
+    // a value that goes up and down
+    class Gauge final {
+    public:
+        using this_type = Gauge;
+
+        Gauge();
+        Gauge(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+        void set(std::int64_t value);
+        void add(std::int64_t amount);
+        std::int64_t get() const;
+
+    private:
+        std::atomic<std::int64_t> value_;
+    }; // END of class Gauge
+
+    // an HDR style histogram: every power of two is split into subBucketCount linear sub buckets,
+    // so any recorded value comes back with less than 1 / subBucketCount relative error, from 0 up to 2^64.
+    class Histogram final {
+    public:
+        using this_type = Histogram;
+        static std::size_t constexpr subBucketBits = 4U;
+        static std::size_t constexpr subBucketCount = 1U << subBucketBits;
+        static std::size_t constexpr amtBuckets = (64U - subBucketBits + 1U) * subBucketCount;
+
+        Histogram();
+        Histogram(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+        void record(std::uint64_t value);
+        std::uint64_t getCount() const;
+        std::uint64_t getSum() const;
+        std::uint64_t getMax() const;
+        std::uint64_t getQuantile(double quantile) const; // the upper bound of the bucket the quantile falls into
+
+    private:
+        static std::size_t bucketOf(std::uint64_t value);
+        static std::uint64_t upperBoundOf(std::size_t bucket);
+
+        std::array<std::atomic<std::uint64_t>, amtBuckets> buckets_;
+        std::atomic<std::uint64_t> count_;
+        std::atomic<std::uint64_t> sum_;
+        std::atomic<std::uint64_t> max_;
+    }; // END of class Histogram
+
+    // owns every metric and renders them in the Prometheus text exposition format.
+    // metrics are created once, up front; the references handed out stay valid for the life of the program,
+    // so the hot paths just keep them and never touch the registry again.
+    class Registry final {
+    public:
+        using this_type = Registry;
+        using Mutex = std::mutex;
+        using Lock = std::unique_lock<Mutex>;
+        using Collector = std::function<void(std::ostream &)>; // writes whole families of its own, HELP and TYPE included
+        using CollectorId = std::size_t;
+
+        Registry(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+
+        static this_type &getRegistry();
+
+        // labels is the part between the braces, e.g. type="sendMsgGrp"; the same name and labels give the same metric
+        Counter &counter(std::string const &name, std::string const &help, std::string const &labels = "");
+        Gauge &gauge(std::string const &name, std::string const &help, std::string const &labels = "");
+        Histogram &histogram(std::string const &name, std::string const &help, std::string const &labels = "");
+        CollectorId addCollector(Collector collector); // for values that are computed when they're scraped
+        void removeCollector(CollectorId id);
+        std::string render() const;
+
+    private:
+        enum class Kind {
+            Counter,
+            Gauge,
+            Histogram
+        }; // END of enum class Kind
+
+        struct Family final {
+            std::string help;
+            Kind kind;
+            std::map<std::string, std::unique_ptr<Counter>> counters; // by labels
+            std::map<std::string, std::unique_ptr<Gauge>> gauges;
+            std::map<std::string, std::unique_ptr<Histogram>> histograms;
+        }; // END of struct Family
+
+        Registry();
+        Family &family(std::string const &name, std::string const &help, Kind kind);
+
+        mutable Mutex mutex_;
+        std::map<std::string, Family> families_; // by name
+        std::map<CollectorId, Collector> collectors_;
+        CollectorId nextCollectorId_;
+    }; // END of class Registry
+
+    // the metrics more than one module updates
+    Counter &bytesReceived();
+    Counter &bytesSent();
+    Counter &decodeFailures();
+    Gauge &activeConnections();
+} // END of namespace metrics
@@ -0,0 +1,69 @@
+#include "MetricsExport.h"
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QByteArray>
+#include <fstream>
+#include <string>
+#include <utility>
+#include "Logger.h"
+
+namespace app {
+    AdminEndpoint::AdminEndpoint(metrics::Registry &registry, QObject *parent)
+        : Base{ parent }, registry_{ registry } {
+        LOG_SCOPE;
+        connect(this, SIGNAL(newConnection()), this, SLOT(newConnectionSlot()));
+    }
+
+    bool AdminEndpoint::listenLocally(quint16 port) {
+        LOG_SCOPE;
+        if (!listen(QHostAddress::LocalHost, port)) {
+            LOG_ERROR << "AdminEndpoint couldn't listen on port " << port << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    void AdminEndpoint::newConnectionSlot() {
+        LOG_SCOPE;
+        while (auto socket = nextPendingConnection()) {
+            connect(socket, SIGNAL(readyRead()), this, SLOT(readyReadSlot()));
+            connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+        }
+    }
+
+    void AdminEndpoint::readyReadSlot() {
+        LOG_SCOPE;
+        auto socket = qobject_cast<QTcpSocket *>(sender());
+        if (socket == nullptr) {
+            LOG_ERROR << "downcast in AdminEndpoint::readyReadSlot failed\n";
+            return;
+        }
+        socket->readAll(); // whatever was asked for, the answer is the same
+
+        auto const body = registry_.render();
+        std::string const header = "HTTP/1.0 200 OK\r\n"
+                                   "Content-Type: text/plain; version=0.0.4\r\n"
+                                   "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                                   "Connection: close\r\n\r\n";
+        socket->write(header.data(), static_cast<qint64>(header.size()));
+        socket->write(body.data(), static_cast<qint64>(body.size()));
+        socket->disconnectFromHost();
+    }
+
+    MetricsDumper::MetricsDumper(metrics::Registry &registry, QString file, int intervalMilliseconds, QObject *parent)
+        : Base{ parent }, registry_{ registry }, file_{ std::move(file) }, timer_{ } {
+        LOG_SCOPE;
+        connect(&timer_, SIGNAL(timeout()), this, SLOT(dumpSlot()));
+        timer_.start(intervalMilliseconds);
+    }
+
+    void MetricsDumper::dumpSlot() {
+        LOG_SCOPE;
+        std::ofstream file{ file_.toStdString(), std::ios::trunc };
+        if (!file) {
+            LOG_WARNING << "MetricsDumper couldn't open " << file_.toStdString() << '\n';
+            return;
+        }
+        file << registry_.render();
+    }
+} // END of namespace app
@@ -0,0 +1,45 @@
+#pragma once
+#include <QObject>
+#include <QTcpServer>
+#include <QTimer>
+#include <QString>
+#include "Metrics.h"
+
+namespace app {
+    // answers every connection on the loopback interface with the rendered metrics as a plain text HTTP response,
+    // which is all a Prometheus style scraper needs. nothing but the local machine can reach it.
+    class AdminEndpoint final : public QTcpServer {
+        Q_OBJECT
+    public:
+        using this_type = AdminEndpoint;
+        using Base = QTcpServer;
+
+        explicit AdminEndpoint(metrics::Registry &registry, QObject *parent = nullptr);
+        bool listenLocally(quint16 port);
+
+    private slots:
+        void newConnectionSlot();
+        void readyReadSlot();
+
+    private:
+        metrics::Registry &registry_;
+    }; // END of class AdminEndpoint
+
+    // writes the rendered metrics to a file every interval
+    class MetricsDumper final : public QObject {
+        Q_OBJECT
+    public:
+        using this_type = MetricsDumper;
+        using Base = QObject;
+
+        MetricsDumper(metrics::Registry &registry, QString file, int intervalMilliseconds, QObject *parent = nullptr);
+
+    private slots:
+        void dumpSlot();
+
+    private:
+        metrics::Registry &registry_;
+        QString file_;
+        QTimer timer_;
+    }; // END of class MetricsDumper
+} // END of namespace app
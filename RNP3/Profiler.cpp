@@ -0,0 +1,222 @@
+#include "Profiler.h"
+#include <algorithm> // std::max
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace profiling {
+    namespace {
+        std::size_t bucketOf(std::uint64_t nanoseconds) {
+            std::size_t bucket = 0U;
+            while (nanoseconds != 0U && bucket + 1U < FunctionStats::amtBuckets) {
+                nanoseconds >>= 1U;
+                ++bucket;
+            }
+            return bucket;
+        }
+
+        // the upper bound of the bucket the given fraction of the calls falls into
+        std::uint64_t percentile(std::array<std::uint64_t, FunctionStats::amtBuckets> const &histogram,
+                                 std::uint64_t calls, double fraction) {
+            auto const wanted = static_cast<std::uint64_t>(static_cast<double>(calls) * fraction);
+            std::uint64_t seen = 0U;
+            for (std::size_t i = 0U; i < histogram.size(); ++i) {
+                seen += histogram[i];
+                if (seen > wanted) {
+                    return static_cast<std::uint64_t>(1U) << i;
+                }
+            }
+            return static_cast<std::uint64_t>(1U) << (histogram.size() - 1U);
+        }
+
+        void addRelaxed(std::atomic<std::uint64_t> &counter, std::uint64_t amount) { // single writer, so no RMW needed
+            counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+        std::string escapeJson(char const *text) {
+            std::string result{ };
+            for (; *text != '\0'; ++text) {
+                if (*text == '"' || *text == '\\') {
+                    result += '\\';
+                }
+                result += *text;
+            }
+            return result;
+        }
+    } // END of anonymous namespace
+
+    Profiler::this_type &Profiler::getProfiler() {
+        static this_type instance{ };
+        return instance;
+    }
+
+    std::uint64_t Profiler::now() {
+        auto const sinceBase = std::chrono::steady_clock::now() - logging::Logger::baseTimestamp_;
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(sinceBase).count());
+    }
+
+    Profiler::Profiler() : mutex_{ }, sites_{ }, threads_{ } { }
+
+    void Profiler::setEnabled(bool isEnabled) {
+        if (isEnabled) {
+            logging::detail::scopeFlags |= logging::detail::scopeProfileFlag;
+        } else {
+            logging::detail::scopeFlags &= ~(logging::detail::scopeProfileFlag | logging::detail::scopeCaptureFlag);
+        }
+    }
+
+    bool Profiler::isEnabled() const {
+        return (logging::detail::scopeFlags & logging::detail::scopeProfileFlag) != 0U;
+    }
+
+    void Profiler::startCapture() {
+        logging::detail::scopeFlags |= logging::detail::scopeProfileFlag | logging::detail::scopeCaptureFlag;
+    }
+
+    bool Profiler::stopCapture(std::string const &traceFile) {
+        logging::detail::scopeFlags &= ~logging::detail::scopeCaptureFlag;
+
+        std::ofstream file{ traceFile, std::ios::trunc };
+        if (!file) {
+            return false;
+        }
+
+        Lock lock{ mutex_ };
+        file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        auto isFirst = true;
+        for (auto const &thread : threads_) {
+            Lock threadLock{ thread->mutex };
+            file << (isFirst ? "" : ",") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                 << thread->threadNumber << ",\"args\":{\"name\":\"thread " << thread->threadNumber << "\"}}";
+            isFirst = false;
+            for (auto const &event : thread->events) {
+                auto const &site = *sites_[static_cast<std::size_t>(event.siteIndex)];
+                file << ",{\"name\":\"" << escapeJson(site.function) << "\",\"cat\":\"scope\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                     << thread->threadNumber << std::fixed << std::setprecision(3)
+                     << ",\"ts\":" << static_cast<double>(event.start) / 1000.0
+                     << ",\"dur\":" << static_cast<double>(event.duration) / 1000.0
+                     << ",\"args\":{\"file\":\"" << escapeJson(site.file) << "\",\"line\":" << site.line << "}}";
+            }
+            if (thread->amtEventsDropped > 0U) {
+                LOG_WARNING << "Profiler::stopCapture: thread " << thread->threadNumber << " dropped "
+                            << thread->amtEventsDropped << " calls\n";
+            }
+            thread->events.clear();
+            thread->events.shrink_to_fit();
+            thread->amtEventsDropped = 0U;
+        }
+        file << "]}\n";
+        return static_cast<bool>(file);
+    }
+
+    std::string Profiler::getReport() const {
+        struct Totals final {
+            std::uint64_t calls = 0U;
+            std::uint64_t totalNanoseconds = 0U;
+            std::uint64_t maxNanoseconds = 0U;
+            std::array<std::uint64_t, FunctionStats::amtBuckets> histogram{ };
+        }; // END of struct Totals
+
+        Lock lock{ mutex_ };
+        std::vector<Totals> totals(sites_.size());
+        for (auto const &thread : threads_) {
+            Lock threadLock{ thread->mutex };
+            for (std::size_t i = 0U; i < thread->stats.size(); ++i) {
+                auto const &stats = thread->stats[i];
+                totals[i].calls += stats.calls.load(std::memory_order_relaxed);
+                totals[i].totalNanoseconds += stats.totalNanoseconds.load(std::memory_order_relaxed);
+                totals[i].maxNanoseconds = std::max(totals[i].maxNanoseconds,
+                                                    stats.maxNanoseconds.load(std::memory_order_relaxed));
+                for (std::size_t bucket = 0U; bucket < FunctionStats::amtBuckets; ++bucket) {
+                    totals[i].histogram[bucket] += stats.histogram[bucket].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        std::ostringstream report{ };
+        report << "function calls total_ns mean_ns p50_ns p99_ns max_ns\n";
+        for (std::size_t i = 0U; i < totals.size(); ++i) {
+            auto const &total = totals[i];
+            if (total.calls == 0U) {
+                continue;
+            }
+            report << sites_[i]->function << '@' << sites_[i]->file << ':' << sites_[i]->line << ' '
+                   << total.calls << ' ' << total.totalNanoseconds << ' ' << total.totalNanoseconds / total.calls << ' '
+                   << percentile(total.histogram, total.calls, 0.5) << ' '
+                   << percentile(total.histogram, total.calls, 0.99) << ' ' << total.maxNanoseconds << '\n';
+        }
+        return report.str();
+    }
+
+    void Profiler::reset() {
+        Lock lock{ mutex_ };
+        for (auto const &thread : threads_) {
+            Lock threadLock{ thread->mutex };
+            for (auto &stats : thread->stats) { // racy against the owner, but only ever loses a few calls
+                stats.calls = 0U;
+                stats.totalNanoseconds = 0U;
+                stats.maxNanoseconds = 0U;
+                for (auto &bucket : stats.histogram) {
+                    bucket = 0U;
+                }
+            }
+            thread->events.clear();
+            thread->amtEventsDropped = 0U;
+        }
+    }
+
+    void Profiler::record(logging::ScopeSite const &site, std::uint64_t start, std::uint64_t duration, bool isCaptured) {
+        auto &thread = profileForCurrentThread();
+        auto const index = indexOf(site);
+        auto const position = static_cast<std::size_t>(index);
+        if (position >= thread.stats.size()) {
+            Lock lock{ thread.mutex };
+            thread.stats.resize(position + 1U);
+        }
+
+        auto &stats = thread.stats[position];
+        addRelaxed(stats.calls, 1U);
+        addRelaxed(stats.totalNanoseconds, duration);
+        if (duration > stats.maxNanoseconds.load(std::memory_order_relaxed)) {
+            stats.maxNanoseconds.store(duration, std::memory_order_relaxed);
+        }
+        addRelaxed(stats.histogram[bucketOf(duration)], 1U);
+
+        if (isCaptured) {
+            Lock lock{ thread.mutex }; // uncontended unless the capture is being written out
+            if (thread.events.size() < maxEventsPerThread) {
+                thread.events.push_back(TraceEvent{ index, start, duration });
+            } else {
+                ++thread.amtEventsDropped;
+            }
+        }
+    }
+
+    int Profiler::indexOf(logging::ScopeSite const &site) {
+        auto index = site.index.load(std::memory_order_acquire);
+        if (index >= 0) {
+            return index;
+        }
+
+        Lock lock{ mutex_ };
+        index = site.index.load(std::memory_order_relaxed);
+        if (index < 0) { // first time anyone has seen this site
+            index = static_cast<int>(sites_.size());
+            sites_.push_back(&site);
+            site.index.store(index, std::memory_order_release);
+        }
+        return index;
+    }
+
+    Profiler::ThreadProfile &Profiler::profileForCurrentThread() {
+        thread_local std::shared_ptr<ThreadProfile> profile{ };
+        if (profile == nullptr) {
+            profile = std::make_shared<ThreadProfile>();
+            Lock lock{ mutex_ };
+            profile->threadNumber = static_cast<int>(threads_.size());
+            threads_.push_back(profile);
+        }
+        return *profile;
+    }
+} // END of namespace profiling
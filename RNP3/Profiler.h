@@ -0,0 +1,74 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Logger.h"
+
+namespace profiling {
+    // the statistics of one LOG_SCOPE on one thread. only the owning thread writes them, so the relaxed atomics
+    // are just there to let a report read them while the thread keeps going.
+    struct FunctionStats final {
+        static std::size_t constexpr amtBuckets = 40U; // bucket i counts the calls that took [2^(i-1), 2^i) nanoseconds
+
+        std::atomic<std::uint64_t> calls{ 0U };
+        std::atomic<std::uint64_t> totalNanoseconds{ 0U };
+        std::atomic<std::uint64_t> maxNanoseconds{ 0U };
+        std::array<std::atomic<std::uint64_t>, amtBuckets> histogram{ };
+    }; // END of struct FunctionStats
+
+    // one call, for the trace file
+    struct TraceEvent final {
+        int siteIndex;
+        std::uint64_t start; // nanoseconds since logging::Logger::baseTimestamp_
+        std::uint64_t duration;
+    }; // END of struct TraceEvent
+
+    // turns the LOG_SCOPEs into a profiler. every thread aggregates call counts and latency histograms per function
+    // in storage of its own; capture mode additionally keeps every single call and writes them out as a
+    // Chrome / Perfetto trace event file (open it in chrome://tracing or ui.perfetto.dev).
+    class Profiler final {
+    public:
+        using this_type = Profiler;
+        using Mutex = std::mutex;
+        using Lock = std::unique_lock<Mutex>;
+        static std::size_t constexpr maxEventsPerThread = 1U << 20U; // capture mode drops the calls beyond that
+
+        Profiler(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+
+        static this_type &getProfiler();
+        static std::uint64_t now(); // nanoseconds since logging::Logger::baseTimestamp_
+
+        void setEnabled(bool isEnabled); // aggregation only
+        bool isEnabled() const;
+        void startCapture(); // enables profiling as well
+        bool stopCapture(std::string const &traceFile); // writes the trace; false if the file couldn't be written
+        std::string getReport() const; // one line per function: calls, total, mean, p50, p99 and max
+        void reset(); // forgets the statistics and the captured calls
+
+        void record(logging::ScopeSite const &site, std::uint64_t start, std::uint64_t duration, bool isCaptured);
+
+    private:
+        struct ThreadProfile final {
+            int threadNumber;
+            Mutex mutex; // guards the shape of stats and events; the owner takes it only to grow them
+            std::deque<FunctionStats> stats; // indexed by ScopeSite::index; a deque, so growing it doesn't move anything
+            std::vector<TraceEvent> events;
+            std::size_t amtEventsDropped = 0U;
+        }; // END of struct ThreadProfile
+
+        Profiler();
+        int indexOf(logging::ScopeSite const &site);
+        ThreadProfile &profileForCurrentThread();
+
+        mutable Mutex mutex_; // guards the two vectors
+        std::vector<logging::ScopeSite const *> sites_; // by index
+        std::vector<std::shared_ptr<ThreadProfile>> threads_; // kept after their threads exit, so the numbers stay
+    }; // END of class Profiler
+} // END of namespace profiling
@@ -0,0 +1,164 @@
+#include "Shard.h"
+#include <QTcpServer>
+#include <QHostAddress>
+#include <utility>
+#include "server.h"
+#include "Logger.h"
+
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#endif
+
+namespace app {
+    class ShardListener final : public QTcpServer {
+    public:
+        using this_type = ShardListener;
+        using Base = QTcpServer;
+
+        explicit ShardListener(Shard &shard)
+            : Base{ nullptr }, shard_{ shard } { }
+
+    protected:
+        virtual void incomingConnection(qintptr socketDescriptor) override {
+            LOG_SCOPE;
+#ifdef Q_OS_LINUX
+            shard_.acceptSlot(socketDescriptor);
+#else
+            shard_.server_.nextShard()->accept(socketDescriptor); // only the first shard listens without SO_REUSEPORT
+#endif
+        }
+
+    private:
+        Shard &shard_;
+    }; // END of class ShardListener
+
+    namespace {
+#ifdef Q_OS_LINUX
+        // every shard binds its own socket to the same port, the kernel spreads the incoming connections across them
+        qintptr makeReusePortListener(quint16 port) {
+            LOG_SCOPE;
+            auto const fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0) {
+                return -1;
+            }
+
+            auto const one = 1;
+            sockaddr_in address{ };
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_ANY);
+            address.sin_port = htons(port);
+            if (::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0
+                || ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0
+                || ::bind(fd, reinterpret_cast<sockaddr const *>(&address), sizeof(address)) != 0
+                || ::listen(fd, SOMAXCONN) != 0) {
+                ::close(fd);
+                return -1;
+            }
+            return fd;
+        }
+#endif
+    } // END of anonymous namespace
+
+    Shard::Shard(int index, Server &server, QThread *thread)
+        : Base{ nullptr }, index_{ index }, server_{ server }, listener_{ nullptr },
+          clientManagers_{ }, channel_{ }, isWakeupPending_{ false } {
+        LOG_SCOPE;
+        moveToThread(thread);
+    }
+
+    Shard::~Shard() {
+        LOG_SCOPE;
+        for (auto const &pair : clientManagers_) {
+            server_.unregisterConnection(pair.first);
+        }
+    }
+
+    int Shard::getIndex() const {
+        LOG_SCOPE;
+        return index_;
+    }
+
+    void Shard::listen(quint16 port) {
+        LOG_SCOPE;
+        QMetaObject::invokeMethod(this, "listenSlot", Qt::QueuedConnection, Q_ARG(quint16, port));
+    }
+
+    void Shard::accept(qintptr socketDescriptor) {
+        LOG_SCOPE;
+        QMetaObject::invokeMethod(this, "acceptSlot", Qt::QueuedConnection, Q_ARG(qintptr, socketDescriptor));
+    }
+
+    void Shard::post(ClientManager::Pointer target, utils::Frame frame) {
+        LOG_SCOPE;
+        channel_.push(Delivery{ std::move(target), std::move(frame) });
+        if (!isWakeupPending_.exchange(true)) {
+            QMetaObject::invokeMethod(this, "drainChannelSlot", Qt::QueuedConnection);
+        }
+    }
+
+    void Shard::listenSlot(quint16 port) {
+        LOG_SCOPE;
+        listener_ = std::make_unique<ShardListener>(*this);
+#ifdef Q_OS_LINUX
+        auto const fd = makeReusePortListener(port);
+        if (fd < 0 || !listener_->setSocketDescriptor(fd)) {
+            LOG_ERROR << "Shard " << index_ << " couldn't listen on port " << port << " with SO_REUSEPORT\n";
+        }
+#else
+        if (index_ == 0 && !listener_->listen(QHostAddress::Any, port)) {
+            LOG_ERROR << "Shard " << index_ << " couldn't listen on port " << port << '\n';
+        }
+#endif
+    }
+
+    void Shard::acceptSlot(qintptr socketDescriptor) {
+        LOG_SCOPE;
+        ClientManager::Pointer clientManager{ new ClientManager{ thread(), server_.getSendLimits(), server_.getHeartbeatMonitor(thread()) },
+                                              ClientManager::Deleter{ } };
+        auto const p = clientManager.get();
+        connect(p, SIGNAL(inboxReadySignal(app::ClientManager *)), this, SLOT(drainInboxSlot(app::ClientManager *))); // same thread, so a direct call
+        connect(p, SIGNAL(disconnectedSignal()), this, SLOT(clientDisconnectedSlot()));
+        server_.registerConnection(clientManager, this, thread());
+        clientManagers_.emplace(p, std::move(clientManager));
+        p->start(socketDescriptor);
+    }
+
+    void Shard::drainInboxSlot(app::ClientManager *clientManager) {
+        LOG_SCOPE;
+        clientManager->drainInbox([this, clientManager](utils::Frame frame) {
+            try {
+                server_.dispatch(*clientManager, std::move(frame));
+            } catch (std::logic_error const &ex) {
+                LOG_DEBUG << "Caught logic_error in Shard::drainInboxSlot:\n" << ex.what() << '\n';
+            } catch (...) { // must not escape, or the connection's drain never finishes
+                LOG_ERROR << "Unknown exception caught in Shard::drainInboxSlot\n";
+            }
+        });
+    }
+
+    void Shard::clientDisconnectedSlot() {
+        LOG_SCOPE;
+        auto clientManager = qobject_cast<ClientManager *>(sender());
+        auto it = clientManagers_.find(clientManager);
+        if (it == std::end(clientManagers_)) {
+            return;
+        }
+
+        server_.unregisterConnection(clientManager);
+        clientManagers_.erase(it); // the Deleter defers the delete, as we're inside one of its signals
+    }
+
+    void Shard::drainChannelSlot() {
+        LOG_SCOPE;
+        isWakeupPending_ = false; // anything posted from here on schedules another drain
+        while (auto delivery = channel_.tryPop()) {
+            if (clientManagers_.count(delivery->target.get()) == 0U) { // disconnected since, it's only kept alive by the delivery
+                LOG_DEBUG << "Shard " << index_ << ": dropping a delivery for a connection that's gone\n";
+                continue;
+            }
+            delivery->target->writeToSocket(delivery->frame);
+        }
+    }
+} // END of namespace app
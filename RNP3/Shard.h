@@ -0,0 +1,55 @@
+#pragma once
+#include <QObject>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include "ClientManager.h"
+#include "Frame.h"
+#include "MessageQueue.h"
+
+namespace app {
+    class Server;
+    class ShardListener;
+
+    // one independent event loop of a sharded server: it owns its own listening socket and its own connections,
+    // and the frames of those connections are dispatched right on the shard's thread.
+    class Shard final : public QObject {
+        Q_OBJECT
+    public:
+        using this_type = Shard;
+        using Base = QObject;
+
+        struct Delivery final { // a frame that another shard wants written to one of this shard's connections
+            using this_type = Delivery;
+            ClientManager::Pointer target; // keeps the connection alive, so its address can't be reused meanwhile
+            utils::Frame frame;
+        }; // END of struct Delivery
+
+        using container_type = std::unordered_map<ClientManager *, ClientManager::Pointer>;
+
+        Shard(int index, Server &server, QThread *thread);
+        ~Shard();
+        int getIndex() const;
+        void listen(quint16 port); // may be called from any thread
+        void accept(qintptr socketDescriptor); // may be called from any thread
+        void post(ClientManager::Pointer target, utils::Frame frame); // the inter-shard channel; may be called from any thread
+
+    private slots:
+        void listenSlot(quint16 port);
+        void acceptSlot(qintptr socketDescriptor);
+        void drainInboxSlot(app::ClientManager *clientManager);
+        void clientDisconnectedSlot();
+        void drainChannelSlot();
+
+    private:
+        friend class ShardListener;
+
+        int index_;
+        Server &server_;
+        std::unique_ptr<ShardListener> listener_;
+        container_type clientManagers_;
+        utils::ThreadSafeQueue<Delivery> channel_;
+        std::atomic_bool isWakeupPending_; // makes sure a burst of deliveries costs a single wakeup of the shard
+    }; // END of class Shard
+} // END of namespace app
@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace utils {
+    // a bounded queue between exactly one producer thread and exactly one consumer thread.
+    // pushing and popping neither lock nor allocate: the slots are allocated once, up front.
+    template <class ValueType>
+    class SpscRing final {
+    public:
+        using this_type = SpscRing;
+        using value_type = ValueType;
+        using container_type = std::vector<value_type>;
+
+        explicit SpscRing(std::size_t capacity); // rounded up to the next power of two
+        SpscRing(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+        bool tryPush(value_type &&value); // producer only; leaves value alone and returns false if the ring is full
+        std::optional<value_type> tryPop(); // consumer only; std::nullopt if the ring is empty
+        bool isFull() const; // exact for the producer, a snapshot for anyone else
+        std::size_t size() const; // exact for the consumer, a snapshot for anyone else
+        std::size_t capacity() const;
+
+    private:
+        static std::size_t constexpr cacheLineSize = 64U;
+
+        static std::size_t roundUpToPowerOfTwo(std::size_t value);
+
+        container_type slots_;
+        std::size_t mask_;
+        alignas(cacheLineSize) std::atomic<std::size_t> head_; // the next slot to pop; only the consumer writes it
+        alignas(cacheLineSize) std::atomic<std::size_t> tail_; // the next slot to push; only the producer writes it
+    }; // END of class SpscRing
+
+    template <class ValueType>
+    SpscRing<ValueType>::SpscRing(std::size_t capacity)
+        : slots_(roundUpToPowerOfTwo(capacity)), mask_{ slots_.size() - 1U }, head_{ 0U }, tail_{ 0U } {
+    }
+
+    template <class ValueType>
+    bool SpscRing<ValueType>::tryPush(value_type &&value) {
+        auto const tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+            return false;
+        }
+        slots_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1U, std::memory_order_release); // publishes the slot to the consumer
+        return true;
+    }
+
+    template <class ValueType>
+    std::optional<typename SpscRing<ValueType>::value_type> SpscRing<ValueType>::tryPop() {
+        auto const head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        auto value = std::exchange(slots_[head & mask_], value_type{ }); // don't keep whatever the value refers to alive
+        head_.store(head + 1U, std::memory_order_release); // hands the slot back to the producer
+        return value;
+    }
+
+    template <class ValueType>
+    bool SpscRing<ValueType>::isFull() const {
+        return size() == slots_.size();
+    }
+
+    template <class ValueType>
+    std::size_t SpscRing<ValueType>::size() const {
+        auto const head = head_.load(std::memory_order_acquire);
+        return tail_.load(std::memory_order_acquire) - head;
+    }
+
+    template <class ValueType>
+    std::size_t SpscRing<ValueType>::capacity() const {
+        return slots_.size();
+    }
+
+    template <class ValueType>
+    std::size_t SpscRing<ValueType>::roundUpToPowerOfTwo(std::size_t value) {
+        std::size_t result = 1U;
+        while (result < value) {
+            result <<= 1U;
+        }
+        return result;
+    }
+} // END of namespace utils
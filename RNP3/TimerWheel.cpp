@@ -0,0 +1,156 @@
+#include "TimerWheel.h"
+#include <utility>
+#include <algorithm>
+#include "Logger.h"
+
+namespace utils {
+    TimerWheel::TimerWheel()
+        : nodes_{ }, freeNodes_{ }, slots_{ }, expired_{ }, now_{ 0U }, size_{ 0U } {
+        LOG_SCOPE;
+        for (auto &level : slots_) {
+            level.fill(none);
+        }
+    }
+
+    TimerWheel::TimerId TimerWheel::schedule(Tick delay, Callback callback) {
+        LOG_SCOPE;
+        std::uint32_t index = 0U;
+        if (freeNodes_.empty()) {
+            index = static_cast<std::uint32_t>(nodes_.size());
+            nodes_.push_back(Node{ 0U, Callback{ }, none, none, 0U, nullptr, false });
+        } else {
+            index = freeNodes_.back();
+            freeNodes_.pop_back();
+        }
+
+        auto &node = nodes_[index];
+        node.deadline = now_ + std::min(std::max(delay, Tick{ 1U }), maxDelay); // the current tick's slot has been handled already
+        node.callback = std::move(callback);
+        node.isPending = true;
+        insert(index);
+        ++size_;
+        return TimerId{ index, node.generation };
+    }
+
+    bool TimerWheel::cancel(TimerId id) {
+        LOG_SCOPE;
+        if (id.index >= nodes_.size()) {
+            return false;
+        }
+
+        auto &node = nodes_[id.index];
+        if (node.generation != id.generation || !node.isPending) {
+            return false;
+        }
+
+        node.isPending = false;
+        --size_;
+        if (node.slot != nullptr) {
+            unlink(id.index);
+            release(id.index);
+        } // otherwise it's in expired_ and advance releases it instead of firing it
+        return true;
+    }
+
+    void TimerWheel::advance(Tick ticks) {
+        LOG_SCOPE;
+        for (; ticks > 0U; --ticks) {
+            ++now_;
+            // every time a level has completed a turn, the next slot of the level above is spread over it
+            for (std::size_t level = 1U; level < levelCount; ++level) {
+                if ((now_ & ((Tick{ 1U } << (slotBits * level)) - 1U)) != 0U) {
+                    break;
+                }
+                cascade(level);
+            }
+
+            auto &slot = slots_[0][now_ & (slotCount - 1U)];
+            for (auto index = slot; index != none; index = nodes_[index].next) {
+                nodes_[index].slot = nullptr;
+                expired_.push_back(index);
+            }
+            slot = none;
+
+            for (std::size_t i = 0U; i < expired_.size(); ++i) { // a callback may schedule timers, which must not fire in this tick
+                auto const index = expired_[i];
+                if (nodes_[index].isPending) {
+                    nodes_[index].isPending = false;
+                    --size_;
+                    auto callback = std::move(nodes_[index].callback); // may reallocate nodes_
+                    release(index);
+                    callback();
+                } else { // cancelled by one of the callbacks before it
+                    release(index);
+                }
+            }
+            expired_.clear();
+        }
+    }
+
+    TimerWheel::Tick TimerWheel::now() const {
+        LOG_SCOPE;
+        return now_;
+    }
+
+    std::size_t TimerWheel::size() const {
+        LOG_SCOPE;
+        return size_;
+    }
+
+    void TimerWheel::insert(std::uint32_t index) {
+        LOG_SCOPE;
+        auto &node = nodes_[index];
+        auto const delay = node.deadline - now_;
+        auto level = levelCount - 1U;
+        for (std::size_t i = 1U; i < levelCount; ++i) {
+            if (delay < (Tick{ 1U } << (slotBits * i))) {
+                level = i - 1U;
+                break;
+            }
+        }
+
+        auto &slot = slots_[level][(node.deadline >> (slotBits * level)) & (slotCount - 1U)];
+        node.previous = none;
+        node.next = slot;
+        if (slot != none) {
+            nodes_[slot].previous = index;
+        }
+        slot = index;
+        node.slot = &slot;
+    }
+
+    void TimerWheel::unlink(std::uint32_t index) {
+        LOG_SCOPE;
+        auto &node = nodes_[index];
+        if (node.previous != none) {
+            nodes_[node.previous].next = node.next;
+        } else {
+            *node.slot = node.next;
+        }
+        if (node.next != none) {
+            nodes_[node.next].previous = node.previous;
+        }
+        node.slot = nullptr;
+    }
+
+    void TimerWheel::cascade(std::size_t level) {
+        LOG_SCOPE;
+        auto &slot = slots_[level][(now_ >> (slotBits * level)) & (slotCount - 1U)];
+        auto index = slot;
+        slot = none;
+        while (index != none) {
+            auto const next = nodes_[index].next;
+            insert(index); // they're all due within this level's slot, so they end up further down
+            index = next;
+        }
+    }
+
+    void TimerWheel::release(std::uint32_t index) {
+        LOG_SCOPE;
+        auto &node = nodes_[index];
+        node.callback = nullptr;
+        node.slot = nullptr;
+        ++node.generation;
+        freeNodes_.push_back(index);
+    }
+} // END of namespace utils
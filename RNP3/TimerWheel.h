@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <functional>
+
+namespace utils {
+    // a hierarchical timer wheel: levelCount wheels of slotCount slots each, every slot of a level spanning a whole
+    // turn of the level below it. scheduling and cancelling are O(1), and so is a tick apart from the timers that
+    // expire or move down a level, so thousands of connections can have a timeout each without a timer per connection.
+    // the wheel doesn't know about time, whoever owns it calls advance once per tick. it's not thread safe.
+    class TimerWheel final {
+    public:
+        using this_type = TimerWheel;
+        using Callback = std::function<void()>;
+        using Tick = std::uint64_t;
+
+        struct TimerId final { // stays valid after its timer has fired or been cancelled, cancelling it is harmless then
+            using this_type = TimerId;
+            std::uint32_t index = UINT32_MAX; // a default constructed id doesn't refer to any timer
+            std::uint32_t generation = 0U;
+        }; // END of struct TimerId
+
+        static std::size_t constexpr slotBits = 6U;
+        static std::size_t constexpr slotCount = std::size_t{ 1U } << slotBits;
+        static std::size_t constexpr levelCount = 4U;
+        static Tick constexpr maxDelay = (Tick{ 1U } << (slotBits * levelCount)) - 1U; // longer delays are cut down to this
+
+        TimerWheel();
+        TimerWheel(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+        TimerId schedule(Tick delay, Callback callback); // fires after delay ticks, at least one
+        bool cancel(TimerId id); // whether the timer was still pending
+        void advance(Tick ticks = 1U); // fires the timers that are due; they may schedule and cancel timers themselves
+        Tick now() const;
+        std::size_t size() const; // the timers that are pending
+
+    private:
+        static std::uint32_t constexpr none = UINT32_MAX;
+
+        struct Node final {
+            using this_type = Node;
+            Tick deadline;
+            Callback callback;
+            std::uint32_t previous;
+            std::uint32_t next;
+            std::uint32_t generation;
+            std::uint32_t *slot; // the list the node is linked into; nullptr while it's free or about to fire
+            bool isPending;
+        }; // END of struct Node
+
+        void insert(std::uint32_t index);
+        void unlink(std::uint32_t index);
+        void cascade(std::size_t level); // moves the timers of the current slot of level down to the levels below
+        void release(std::uint32_t index);
+
+        std::vector<Node> nodes_;
+        std::vector<std::uint32_t> freeNodes_;
+        std::array<std::array<std::uint32_t, slotCount>, levelCount> slots_; // the first node of every slot's list
+        std::vector<std::uint32_t> expired_; // the timers of the tick that is firing, reused from tick to tick
+        Tick now_;
+        std::size_t size_;
+    }; // END of class TimerWheel
+} // END of namespace utils
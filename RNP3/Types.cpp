@@ -1,31 +1,89 @@
 #include "Types.h"
 #include <utility>
+#include <algorithm>
+#include "WireFormat.h"
 #include "Logger.h"
 
-#ifdef RESERVED_BYTE
-	static_assert(false, "RESERVED_BYTE was already defined in Types.cpp");
-#endif // RESERVED_BYTE
+namespace {
+    // writes exactly byteCount bytes of text, padding with zeros if the text is shorter than that
+    char *writeText(char *ptr, std::string const &text, std::size_t byteCount) {
+        auto const bytesOfText = std::min(text.size(), byteCount);
+        ptr = std::copy_n(text.data(), bytesOfText, ptr);
+        return std::fill_n(ptr, byteCount - bytesOfText, '\0');
+    }
 
-#define RESERVED_BYTE 
+    void gatherText(utils::GatherList &list, std::string const &text, std::size_t byteCount) {
+        auto const bytesOfText = std::min(text.size(), byteCount);
+        list.add(text.data(), bytesOfText);
+        list.addZeros(byteCount - bytesOfText);
+    }
+} // END of anonymous namespace
 
 namespace utils {
+    std::size_t paddedUsernameLength(std::size_t lengthUsername) {
+        LOG_SCOPE;
+        auto const additionalBytes = bitAlignment - lengthUsername % bitAlignment;
+        return lengthUsername + additionalBytes;
+    }
+
+    AddressKey makeAddressKey(Word ip, HalfWord port) {
+        LOG_SCOPE;
+        return (static_cast<AddressKey>(ip) << 16U) | static_cast<AddressKey>(port);
+    }
+
+    Word getIp(AddressKey key) {
+        LOG_SCOPE;
+        return static_cast<Word>(key >> 16U);
+    }
+
+    HalfWord getPort(AddressKey key) {
+        LOG_SCOPE;
+        return static_cast<HalfWord>(key & 0xFFFFU);
+    }
+
+    std::string_view getName(MessageType type) {
+        LOG_SCOPE;
+        switch (type) {
+            case MessageType::reqFindServer: return "reqFindServer";
+            case MessageType::resFindServer: return "resFindServer";
+            case MessageType::reqLogin: return "reqLogin";
+            case MessageType::updateClientList: return "updateClientList";
+            case MessageType::sendMsgGrp: return "sendMsgGrp";
+            case MessageType::sendMsgUsr: return "sendMsgUsr";
+            case MessageType::reqHeartbeat: return "reqHeartbeat";
+            case MessageType::resHeartbeat: return "resHeartbeat";
+            case MessageType::errorMsgNotDelivered: return "errorMsgNotDelivered";
+            case MessageType::updateClientListDelta: return "updateClientListDelta";
+            case MessageType::reqClientList: return "reqClientList";
+        }
+        return "unknown";
+    }
+
     Message::Message(Word version, MessageType type, Word length)
         : version_{ version }, type_{ type }, length_{ length } {
         LOG_SCOPE;
     }
 
-    Message::~Message() = default;
+    std::size_t Message::encodedSize() const {
+        LOG_SCOPE;
+        return commonHeaderByteSize;
+    }
+
+    char *Message::serializeInto(char *buffer) const {
+        LOG_SCOPE;
+        return wire::CommonHeader::storeAll(buffer, version_, type_, length_);
+    }
 
-    QByteArray Message::toByteArray() const {
+    void Message::gatherInto(GatherList &list) const {
         LOG_SCOPE;
-        QByteArray ret{ commonHeaderByteSize, '\0' };
-        auto ptr = ret.data();
-        writeToAddress(ptr, version_);
-        advancePtr(ptr, sizeof(Word));
-        writeToAddress(ptr, type_);
-        advancePtr(ptr, sizeof(MessageType));
-        writeToAddress(ptr, length_);
-        return ret;
+        auto const header = list.allocateScratch(commonHeaderByteSize);
+        this_type::serializeInto(header);
+        list.add(header, commonHeaderByteSize);
+    }
+
+    std::size_t Message::gatherScratchSize() const {
+        LOG_SCOPE;
+        return commonHeaderByteSize;
     }
     
     Word Message::getVersion() const {
@@ -44,18 +102,28 @@ namespace utils {
     }
 
     ReqLoginMessage::ReqLoginMessage(Word version, MessageType type, Word length, std::string userName)
-        : Message{ version, type, length }, username_{ std::move(userName) } {
+        : Base{ version, type, length }, username_{ std::move(userName) } {
         LOG_SCOPE;
     }
 
-    QByteArray ReqLoginMessage::toByteArray() const {
+    std::size_t ReqLoginMessage::encodedSize() const {
         LOG_SCOPE;
-        auto bytes = Base::toByteArray();
-        bytes.append(username_.data(), getLength());
-        return bytes;
+        return Base::encodedSize() + getLength();
+    }
+
+    char *ReqLoginMessage::serializeInto(char *buffer) const {
+        LOG_SCOPE;
+        buffer = Base::serializeInto(buffer);
+        return writeText(buffer, username_, getLength());
     }
 
-    std::string ReqLoginMessage::getUsername() const {
+    void ReqLoginMessage::gatherInto(GatherList &list) const {
+        LOG_SCOPE;
+        Base::gatherInto(list);
+        gatherText(list, username_, getLength());
+    }
+
+    std::string_view ReqLoginMessage::getUsername() const {
         LOG_SCOPE;
         return username_;
     }
@@ -81,39 +149,40 @@ namespace utils {
         return lengthUsername_;
     }
 
-    std::string UsernameRecord::getUsername() const {
+    std::string_view UsernameRecord::getUsername() const {
         LOG_SCOPE;
         return username_;
     }
 
     QByteArray UsernameRecord::toByteArray() const {
         LOG_SCOPE;
-        auto const extraPadding = bitAlignment - bitAlignment % username_.size();
-        auto const totalStringBytes = username_.size() + extraPadding;
-        if (totalStringBytes % bitAlignment != 0) {
-            throw std::logic_error{ "totalStringBytes in UsernameRecord::toByteArray was not a multiple of 32" };
-        }
+        QByteArray bytes{ static_cast<int>(encodedSize()), Qt::Uninitialized };
+        serializeInto(bytes.data());
+        return bytes;
+    }
 
-        QByteArray bytes{ sizeof(Word) + sizeof(HalfWord) +
-                          sizeof(Byte) + RESERVED_BYTE sizeof(Byte), '\0' };
-
-        auto ptr = bytes.data();
-        writeToAddress(ptr, ip_);
-        advancePtr(ptr, sizeof(Word));
-        writeToAddress(ptr, port_);
-        advancePtr(ptr, sizeof(HalfWord));
-        writeToAddress(ptr, lengthUsername_);
-        bytes.append(username_.data(), lengthUsername_);
-        for (auto i = 0; i < extraPadding; ++i) {
-            bytes.append('\0');
-        }
+    std::size_t UsernameRecord::encodedSize() const {
+        LOG_SCOPE;
+        return usernameRecordStaticByteSize + paddedUsernameLength(lengthUsername_);
+    }
 
-        return bytes;
+    char *UsernameRecord::serializeInto(char *buffer) const {
+        LOG_SCOPE;
+        buffer = wire::UsernameRecord::storeAll(buffer, ip_, port_, lengthUsername_, static_cast<Byte>(0U)); // the reserved byte
+        return writeText(buffer, username_, paddedUsernameLength(lengthUsername_));
+    }
+
+    void UsernameRecord::gatherInto(GatherList &list) const {
+        LOG_SCOPE;
+        auto const header = list.allocateScratch(usernameRecordStaticByteSize);
+        wire::UsernameRecord::storeAll(header, ip_, port_, lengthUsername_, static_cast<Byte>(0U)); // the reserved byte
+        list.add(header, usernameRecordStaticByteSize);
+        gatherText(list, username_, paddedUsernameLength(lengthUsername_));
     }
    
     UpdateClientListMessage::UpdateClientListMessage(Word version, MessageType type, Word length,
                                                      container_type cont)
-        : Message{ version, type, length }, 
+        : Base{ version, type, length }, 
           records_{ std::move(cont) } {
         LOG_SCOPE;
     }
@@ -188,16 +257,114 @@ namespace utils {
         return records_.crend();
     }
 
-    QByteArray UpdateClientListMessage::toByteArray() const {
+    std::size_t UpdateClientListMessage::encodedSize() const {
         LOG_SCOPE;
-        auto bytes = Base::toByteArray();
+        auto size = Base::encodedSize();
         for (auto const &e : records_) {
-            bytes.append(e.toByteArray());
+            size += e.encodedSize();
         }
-        return bytes;
+        return size;
     }
 
-    SendMessageBase::~SendMessageBase() = default;
+    char *UpdateClientListMessage::serializeInto(char *buffer) const {
+        LOG_SCOPE;
+        buffer = Base::serializeInto(buffer);
+        for (auto const &e : records_) {
+            buffer = e.serializeInto(buffer);
+        }
+        return buffer;
+    }
+
+    void UpdateClientListMessage::gatherInto(GatherList &list) const {
+        LOG_SCOPE;
+        Base::gatherInto(list);
+        for (auto const &e : records_) {
+            e.gatherInto(list);
+        }
+    }
+
+    std::size_t UpdateClientListMessage::gatherScratchSize() const {
+        LOG_SCOPE;
+        return Base::gatherScratchSize() + records_.size() * usernameRecordStaticByteSize;
+    }
+
+    UpdateClientListDeltaMessage::UpdateClientListDeltaMessage(Word version, MessageType type, Word length,
+                                                               Word baseVersion, Word rosterVersion,
+                                                               container_type added, container_type removed)
+        : Base{ version, type, length }, baseVersion_{ baseVersion }, rosterVersion_{ rosterVersion },
+          added_{ std::move(added) }, removed_{ std::move(removed) } {
+        LOG_SCOPE;
+    }
+
+    Word UpdateClientListDeltaMessage::getBaseVersion() const {
+        LOG_SCOPE;
+        return baseVersion_;
+    }
+
+    Word UpdateClientListDeltaMessage::getRosterVersion() const {
+        LOG_SCOPE;
+        return rosterVersion_;
+    }
+
+    bool UpdateClientListDeltaMessage::isFullRoster() const {
+        LOG_SCOPE;
+        return baseVersion_ == fullRoster;
+    }
+
+    UpdateClientListDeltaMessage::container_type const &UpdateClientListDeltaMessage::getAdded() const {
+        LOG_SCOPE;
+        return added_;
+    }
+
+    UpdateClientListDeltaMessage::container_type const &UpdateClientListDeltaMessage::getRemoved() const {
+        LOG_SCOPE;
+        return removed_;
+    }
+
+    std::size_t UpdateClientListDeltaMessage::encodedSize() const {
+        LOG_SCOPE;
+        auto size = Base::encodedSize() + clientListDeltaStaticByteSize;
+        for (auto const &e : added_) {
+            size += e.encodedSize();
+        }
+        for (auto const &e : removed_) {
+            size += e.encodedSize();
+        }
+        return size;
+    }
+
+    char *UpdateClientListDeltaMessage::serializeInto(char *buffer) const {
+        LOG_SCOPE;
+        buffer = Base::serializeInto(buffer);
+        buffer = wire::ClientListDelta::storeAll(buffer, baseVersion_, rosterVersion_, static_cast<Word>(added_.size()));
+        for (auto const &e : added_) {
+            buffer = e.serializeInto(buffer);
+        }
+        for (auto const &e : removed_) {
+            buffer = e.serializeInto(buffer);
+        }
+        return buffer;
+    }
+
+    void UpdateClientListDeltaMessage::gatherInto(GatherList &list) const {
+        LOG_SCOPE;
+        Base::gatherInto(list);
+        auto const header = list.allocateScratch(clientListDeltaStaticByteSize);
+        wire::ClientListDelta::storeAll(header, baseVersion_, rosterVersion_, static_cast<Word>(added_.size()));
+        list.add(header, clientListDeltaStaticByteSize);
+        for (auto const &e : added_) {
+            e.gatherInto(list);
+        }
+        for (auto const &e : removed_) {
+            e.gatherInto(list);
+        }
+    }
+
+    std::size_t UpdateClientListDeltaMessage::gatherScratchSize() const {
+        LOG_SCOPE;
+        return Base::gatherScratchSize() + clientListDeltaStaticByteSize
+            + (added_.size() + removed_.size()) * usernameRecordStaticByteSize;
+    }
 
     SendMessageBase::SendMessageBase(Word version, MessageType type, Word length, Word messageId, Word sourceIp, Word targetIp, HalfWord sourcePort, HalfWord targetPort) 
         : Message{ version, type, length },
@@ -231,75 +398,88 @@ namespace utils {
         return targetPort_;
     }
 
-    QByteArray SendMessageBase::toByteArray() const {
+    std::size_t SendMessageBase::encodedSize() const {
+        LOG_SCOPE;
+        return Base::encodedSize() + sendMsgStructByteSize;
+    }
+
+    char *SendMessageBase::serializeInto(char *buffer) const {
         LOG_SCOPE;
-        auto result = Base::toByteArray();
-        QByteArray sendMessageByteArray{ 3 * sizeof(Word) + 2 * sizeof(HalfWord), '\0' };
-        auto ptr = sendMessageByteArray.data();
-        writeToAddress(ptr, messageId_);
-        advancePtr(ptr, sizeof(Word));
-        writeToAddress(ptr, sourceIp_);
-        advancePtr(ptr, sizeof(Word));
-        writeToAddress(ptr, targetIp_);
-        advancePtr(ptr, sizeof(Word));
-        writeToAddress(ptr, sourcePort_);
-        advancePtr(ptr, sizeof(HalfWord));
-        writeToAddress(ptr, targetPort_);
-        result.append(sendMessageByteArray);
-        return result;
+        buffer = Base::serializeInto(buffer);
+        return wire::SendMsgStruct::storeAll(buffer, messageId_, sourceIp_, targetIp_, sourcePort_, targetPort_);
+    }
+
+    void SendMessageBase::gatherInto(GatherList &list) const {
+        LOG_SCOPE;
+        auto const header = list.allocateScratch(this_type::gatherScratchSize());
+        this_type::serializeInto(header);
+        list.add(header, this_type::gatherScratchSize());
+    }
+
+    std::size_t SendMessageBase::gatherScratchSize() const {
+        LOG_SCOPE;
+        return commonHeaderByteSize + sendMsgStructByteSize;
     }
 
     SendMsgGrpMessage::SendMsgGrpMessage(Word version, MessageType type, Word length, Word messageId, Word sourceIp, Word targetIp, HalfWord sourcePort, HalfWord targetPort, std::string messageText)
-        : SendMessageBase{ version, type, length, messageId, sourceIp, targetIp, sourcePort, targetPort },
+        : Base{ version, type, length, messageId, sourceIp, targetIp, sourcePort, targetPort },
         messageText_{ std::move(messageText) }, messageTextStringLength_{ length - sendMsgStructByteSize } {
         LOG_SCOPE;
     }
 
-    std::string SendMsgGrpMessage::getMessageText() const {
+    std::string_view SendMsgGrpMessage::getMessageText() const {
         LOG_SCOPE;
         return messageText_;
     }
 
-    QByteArray SendMsgGrpMessage::toByteArray() const {
+    std::size_t SendMsgGrpMessage::encodedSize() const {
         LOG_SCOPE;
-        auto bytes = Base::toByteArray();
-        bytes.append(messageText_.data(), messageTextStringLength_);
-        return bytes;
+        return Base::encodedSize() + messageTextStringLength_;
+    }
+
+    char *SendMsgGrpMessage::serializeInto(char *buffer) const {
+        LOG_SCOPE;
+        buffer = Base::serializeInto(buffer);
+        return writeText(buffer, messageText_, messageTextStringLength_);
+    }
+
+    void SendMsgGrpMessage::gatherInto(GatherList &list) const {
+        LOG_SCOPE;
+        Base::gatherInto(list);
+        gatherText(list, messageText_, messageTextStringLength_);
     }
 
     SendMsgUsrMessage::SendMsgUsrMessage(Word version, MessageType type, Word length, Word messageId, Word sourceIp, Word targetIp, HalfWord sourcePort, HalfWord targetPort, std::string messageText)
-        : SendMessageBase{ version, type, length, messageId, sourceIp, targetIp, sourcePort, targetPort },
+        : Base{ version, type, length, messageId, sourceIp, targetIp, sourcePort, targetPort },
         messageText_{ std::move(messageText) }, messageTextStringLength_{ length - sendMsgStructByteSize } {
         LOG_SCOPE;
     }
 
-    std::string SendMsgUsrMessage::getMessageText() const {
+    std::string_view SendMsgUsrMessage::getMessageText() const {
         LOG_SCOPE;
         return messageText_;
     }
 
-    QByteArray SendMsgUsrMessage::toByteArray() const {
+    std::size_t SendMsgUsrMessage::encodedSize() const {
         LOG_SCOPE;
-        auto bytes = Base::toByteArray();
-        bytes.append(messageText_.data(), messageTextStringLength_);
-        return bytes;
+        return Base::encodedSize() + messageTextStringLength_;
+    }
+
+    char *SendMsgUsrMessage::serializeInto(char *buffer) const {
+        LOG_SCOPE;
+        buffer = Base::serializeInto(buffer);
+        return writeText(buffer, messageText_, messageTextStringLength_);
+    }
+
+    void SendMsgUsrMessage::gatherInto(GatherList &list) const {
+        LOG_SCOPE;
+        Base::gatherInto(list);
+        gatherText(list, messageText_, messageTextStringLength_);
     }
     
     ErrorMsgNotDeliveredMessage::ErrorMsgNotDeliveredMessage(Word version, MessageType type, Word length, Word messageId, Word sourceIp, Word targetIp, HalfWord sourcePort, HalfWord targetPort)
-        : SendMessageBase{ version, type, length, messageId, sourceIp, targetIp, sourcePort, targetPort } {
+        : Base{ version, type, length, messageId, sourceIp, targetIp, sourcePort, targetPort } {
         LOG_SCOPE;
     }
 
-    extern std::unordered_map<std::type_index, MessageType> const rttiTable{
-        { std::type_index{ typeid(ReqFindServerMessage) }, MessageType::reqFindServer },
-        { std::type_index{ typeid(ReqLoginMessage) }, MessageType::reqLogin },
-        { std::type_index{ typeid(ReqHeartbeatMessage) }, MessageType::reqHeartbeat },
-        { std::type_index{ typeid(ResFindServerMessage) }, MessageType::resFindServer },
-        { std::type_index{ typeid(ResHeartbeatMessage) }, MessageType::resHeartbeat },
-        { std::type_index{ typeid(UpdateClientListMessage) }, MessageType::updateClientList },
-        { std::type_index{ typeid(SendMsgGrpMessage) }, MessageType::sendMsgGrp },
-        { std::type_index{ typeid(SendMsgUsrMessage) }, MessageType::sendMsgUsr },
-        { std::type_index{ typeid(ErrorMsgNotDeliveredMessage) }, MessageType::errorMsgNotDelivered }
-    };
-
 } // END of namespace utils
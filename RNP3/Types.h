@@ -1,17 +1,22 @@
 #pragma once
 #include "Utility.h"
+#include "GatherList.h"
 #include <string>
+#include <string_view>
 #include <vector>
+#include <variant>
+#include <utility>
 #include <unordered_map>
-#include <typeinfo>
 #include <cstddef>
-#include <typeindex>
 #include <QByteArray>
 
 namespace utils {
     static auto constexpr bitAlignment = 32;
     static auto constexpr commonHeaderByteSize = 12;
     static auto constexpr sendMsgStructByteSize = 16;
+    static auto constexpr usernameRecordStaticByteSize = 8;
+    static auto constexpr clientListDeltaStaticByteSize = 12; // base version, roster version and the amount of added records
+    static auto constexpr protocolVersion = 1U; // what the server puts into the messages it makes up itself
 
     enum class MessageType : Word {
         reqFindServer = 1U,
@@ -23,16 +28,28 @@ namespace utils {
         reqHeartbeat,
         resHeartbeat,
         errorMsgNotDelivered,
+        updateClientListDelta,
+        reqClientList,
     }; // END of enum class MessageType
 
-    static auto constexpr amtMessageTypes = 9;
+
+    std::size_t paddedUsernameLength(std::size_t lengthUsername); // usernames are padded up to the next multiple of bitAlignment
+
+    // the address a user is connected from as one number; the server's directory and the client's roster are keyed by it
+    using AddressKey = std::uint64_t;
+    AddressKey makeAddressKey(Word ip, HalfWord port);
+    Word getIp(AddressKey key);
+    HalfWord getPort(AddressKey key);
+    std::string_view getName(MessageType type); // the enumerator's name, "unknown" for anything else
    
     class Message {
     public:
         using this_type = Message;
         Message(Word version, MessageType type, Word length);
-        virtual ~Message();
-        virtual QByteArray toByteArray() const;
+        std::size_t encodedSize() const; // the size of the whole frame, common header included
+        char *serializeInto(char *buffer) const; // writes encodedSize() bytes, returns one past the last byte written
+        void gatherInto(GatherList &list) const; // payloads are referenced in place, not copied
+        std::size_t gatherScratchSize() const; // the scratch space gatherInto needs for the fixed size parts
         Word getVersion() const;
         MessageType getType() const;
         Word getLength() const;
@@ -43,49 +60,83 @@ namespace utils {
         Word length_;
     }; // END of class Message
 
-    class ReqFindServerMessage final : public Message {
+    // gives a concrete message its toByteArray and toGatherList.
+    // the encoding functions are found statically through Derived, so the messages don't need a vtable.
+    template <class Derived, class BaseType = Message>
+    class Encodable : public BaseType {
+    public:
+        using this_type = Encodable;
+        using Base = BaseType;
+
+        using BaseType::BaseType;
+
+        QByteArray toByteArray() const { // a single allocation of exactly encodedSize() bytes
+            QByteArray ret{ static_cast<int>(derived().encodedSize()), Qt::Uninitialized };
+            derived().serializeInto(ret.data());
+            return ret;
+        }
+
+        GatherList toGatherList() const {
+            GatherList list{ derived().gatherScratchSize() };
+            derived().gatherInto(list);
+            return list;
+        }
+
+    private:
+        Derived const &derived() const {
+            return static_cast<Derived const &>(*this);
+        }
+    }; // END of class Encodable
+
+    class ReqFindServerMessage final : public Encodable<ReqFindServerMessage> {
     public:
         using this_type = ReqFindServerMessage;
-        using Base = Message;
+        using Base = Encodable<ReqFindServerMessage>;
+        static MessageType constexpr messageType = MessageType::reqFindServer;
 
-        using Message::Message;
+        using Base::Base;
     }; // END of class ReqFindServerMessage
 
-    class ReqLoginMessage final : public Message {
+    class ReqLoginMessage final : public Encodable<ReqLoginMessage> {
     public:
         using this_type = ReqLoginMessage;
-        using Base = Message;
-
-        virtual QByteArray toByteArray() const override;
+        using Base = Encodable<ReqLoginMessage>;
+        static MessageType constexpr messageType = MessageType::reqLogin;
 
         ReqLoginMessage(Word version, MessageType type, Word length, std::string username);
-        std::string getUsername() const;
+        std::size_t encodedSize() const;
+        char *serializeInto(char *buffer) const;
+        void gatherInto(GatherList &list) const;
+        std::string_view getUsername() const;
     private:
         std::string username_;
     }; // END of class ReqLoginMessage
 
-    class ReqHeartbeatMessage final : public Message {
+    class ReqHeartbeatMessage final : public Encodable<ReqHeartbeatMessage> {
     public:
         using this_type = ReqHeartbeatMessage;
-        using Base = Message;
+        using Base = Encodable<ReqHeartbeatMessage>;
+        static MessageType constexpr messageType = MessageType::reqHeartbeat;
 
-        using Message::Message;
+        using Base::Base;
     }; // END of class ReqHeartbeatMessage
 
-    class ResFindServerMessage final : public Message {
+    class ResFindServerMessage final : public Encodable<ResFindServerMessage> {
     public:
         using this_type = ResFindServerMessage;
-        using Base = Message;
+        using Base = Encodable<ResFindServerMessage>;
+        static MessageType constexpr messageType = MessageType::resFindServer;
 
-        using Message::Message;
+        using Base::Base;
     }; // END of class ResFindServerMessage
 
-    class ResHeartbeatMessage final : public Message {
+    class ResHeartbeatMessage final : public Encodable<ResHeartbeatMessage> {
     public:
         using this_type = ResHeartbeatMessage;
-        using Base = Message;
+        using Base = Encodable<ResHeartbeatMessage>;
+        static MessageType constexpr messageType = MessageType::resHeartbeat;
 
-        using Message::Message;
+        using Base::Base;
     }; // END of class ResHeartbeatMessage
 
     class UsernameRecord final {
@@ -95,8 +146,11 @@ namespace utils {
         Word getIp() const;
         HalfWord getPort() const;
         Byte getLengthUsername() const;
-        std::string getUsername() const;
+        std::string_view getUsername() const;
         QByteArray toByteArray() const;
+        std::size_t encodedSize() const;
+        char *serializeInto(char *buffer) const;
+        void gatherInto(GatherList &list) const;
     private:
         Word ip_;
         HalfWord port_;
@@ -104,10 +158,11 @@ namespace utils {
         std::string username_;
     }; // END of class UsernameRecord
 
-    class UpdateClientListMessage final : public Message {
+    class UpdateClientListMessage final : public Encodable<UpdateClientListMessage> {
     public:
         using this_type = UpdateClientListMessage;
-        using Base = Message;
+        using Base = Encodable<UpdateClientListMessage>;
+        static MessageType constexpr messageType = MessageType::updateClientList;
         using value_type = UsernameRecord;
         using container_type = std::vector<UsernameRecord>;
         using iterator = container_type::iterator;
@@ -130,12 +185,55 @@ namespace utils {
         reverse_iterator rend();
         const_reverse_iterator rend() const;
         const_reverse_iterator crend() const;
-        virtual QByteArray toByteArray() const override;
+        std::size_t encodedSize() const;
+        char *serializeInto(char *buffer) const;
+        void gatherInto(GatherList &list) const;
+        std::size_t gatherScratchSize() const;
 
     private:
         container_type records_;
     }; // END of class UpdateClientListMessage
 
+    // the changes to the roster between two roster versions: the records that were added and the ones that were removed.
+    // a base version of 0 marks the full roster; the receiver replaces whatever it had with the added records.
+    class UpdateClientListDeltaMessage final : public Encodable<UpdateClientListDeltaMessage> {
+    public:
+        using this_type = UpdateClientListDeltaMessage;
+        using Base = Encodable<UpdateClientListDeltaMessage>;
+        static MessageType constexpr messageType = MessageType::updateClientListDelta;
+        using value_type = UsernameRecord;
+        using container_type = std::vector<UsernameRecord>;
+
+        static Word constexpr fullRoster = 0U;
+
+        UpdateClientListDeltaMessage(Word version, MessageType type, Word length, Word baseVersion, Word rosterVersion,
+                                     container_type added, container_type removed);
+        Word getBaseVersion() const;
+        Word getRosterVersion() const;
+        bool isFullRoster() const;
+        container_type const &getAdded() const;
+        container_type const &getRemoved() const;
+        std::size_t encodedSize() const;
+        char *serializeInto(char *buffer) const;
+        void gatherInto(GatherList &list) const;
+        std::size_t gatherScratchSize() const;
+
+    private:
+        Word baseVersion_;
+        Word rosterVersion_;
+        container_type added_;
+        container_type removed_;
+    }; // END of class UpdateClientListDeltaMessage
+
+    class ReqClientListMessage final : public Encodable<ReqClientListMessage> { // asks for the full roster after a client missed a delta
+    public:
+        using this_type = ReqClientListMessage;
+        using Base = Encodable<ReqClientListMessage>;
+        static MessageType constexpr messageType = MessageType::reqClientList;
+
+        using Base::Base;
+    }; // END of class ReqClientListMessage
+
     class SendMessageBase : public Message {
     public:
         using this_type = SendMessageBase;
@@ -143,13 +241,15 @@ namespace utils {
 
         SendMessageBase(Word version, MessageType type, Word length, Word messageId,
                         Word sourceIp, Word targetIp, HalfWord sourcePort, HalfWord targetPort);
-        virtual ~SendMessageBase();
         Word getMessageId() const;
         Word getSourceIp() const;
         Word getTargetIp() const;
         HalfWord getSourcePort() const;
         HalfWord getTargetPort() const;
-        virtual QByteArray toByteArray() const override;
+        std::size_t encodedSize() const;
+        char *serializeInto(char *buffer) const;
+        void gatherInto(GatherList &list) const;
+        std::size_t gatherScratchSize() const;
 
     protected:
         Word messageId_;
@@ -159,48 +259,72 @@ namespace utils {
         HalfWord targetPort_;
     }; // END of class SendMessageBase
 
-    class SendMsgGrpMessage final : public SendMessageBase {
+    class SendMsgGrpMessage final : public Encodable<SendMsgGrpMessage, SendMessageBase> {
     public:
         using this_type = SendMsgGrpMessage;
-        using Base = SendMessageBase;
+        using Base = Encodable<SendMsgGrpMessage, SendMessageBase>;
+        static MessageType constexpr messageType = MessageType::sendMsgGrp;
 
         SendMsgGrpMessage(Word version, MessageType type, Word length, Word messageId,
                           Word sourceIp, Word targetIp, HalfWord sourcePort, HalfWord targetPort,
                           std::string messageText);
 
-        std::string getMessageText() const;
+        std::string_view getMessageText() const;
 
-        virtual QByteArray toByteArray() const override;
+        std::size_t encodedSize() const;
+        char *serializeInto(char *buffer) const;
+        void gatherInto(GatherList &list) const;
     private:
         std::string messageText_;
-        Word const messageTextStringLength_;
+        Word messageTextStringLength_;
     }; // END of class SendMsgGrpMessage
 
-    class SendMsgUsrMessage final : public SendMessageBase {
+    class SendMsgUsrMessage final : public Encodable<SendMsgUsrMessage, SendMessageBase> {
     public:
         using this_type = SendMsgUsrMessage;
-        using Base = SendMessageBase;
+        using Base = Encodable<SendMsgUsrMessage, SendMessageBase>;
+        static MessageType constexpr messageType = MessageType::sendMsgUsr;
 
         SendMsgUsrMessage(Word version, MessageType type, Word length, Word messageId,
                           Word sourceIp, Word targetIp, HalfWord sourcePort, HalfWord targetPort,
                           std::string messageText);
 
-        std::string getMessageText() const;
-        virtual QByteArray toByteArray() const override;
+        std::string_view getMessageText() const;
+        std::size_t encodedSize() const;
+        char *serializeInto(char *buffer) const;
+        void gatherInto(GatherList &list) const;
 
     private:
         std::string messageText_;
-        Word const messageTextStringLength_;
+        Word messageTextStringLength_;
     }; // END of class SendMsgUsrMessage
 
-    class ErrorMsgNotDeliveredMessage final : public SendMessageBase {
+    class ErrorMsgNotDeliveredMessage final : public Encodable<ErrorMsgNotDeliveredMessage, SendMessageBase> {
     public:
         using this_type = ErrorMsgNotDeliveredMessage;
-        using Base = SendMessageBase;
+        using Base = Encodable<ErrorMsgNotDeliveredMessage, SendMessageBase>;
+        static MessageType constexpr messageType = MessageType::errorMsgNotDelivered;
 
         ErrorMsgNotDeliveredMessage(Word version, MessageType type, Word length, Word messageId,
             Word sourceIp, Word targetIp, HalfWord sourcePort, HalfWord targetPort);
     }; // END of class ErrorMsgNotDeliveredMessage
 
-    extern std::unordered_map<std::type_index, MessageType> const rttiTable;
+    // every message in the order of MessageType. the decoder table, the variant and amtMessageTypes are all derived from this list.
+    using MessageTypeList = type_list<ReqFindServerMessage, ResFindServerMessage, ReqLoginMessage, UpdateClientListMessage,
+                                      SendMsgGrpMessage, SendMsgUsrMessage, ReqHeartbeatMessage, ResHeartbeatMessage,
+                                      ErrorMsgNotDeliveredMessage, UpdateClientListDeltaMessage, ReqClientListMessage>;
+
+    using AnyMessage = MessageTypeList::apply<std::variant>; // a decoded message by value
+
+    static auto constexpr amtMessageTypes = MessageTypeList::size;
+
+    namespace detail {
+        template <std::size_t... Indices>
+        constexpr bool isInMessageTypeOrder(std::index_sequence<Indices...>) {
+            return ((static_cast<Word>(type_at_t<Indices, MessageTypeList>::messageType) == Indices + 1U) && ...);
+        }
+    } // END of namespace detail
+
+    static_assert(detail::isInMessageTypeOrder(std::make_index_sequence<amtMessageTypes>{ }),
+                  "MessageTypeList has to list the messages in the order of MessageType");
 } // END of namespace utils
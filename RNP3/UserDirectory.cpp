@@ -0,0 +1,111 @@
+#include "UserDirectory.h"
+#include <utility>
+#include "Logger.h"
+
+namespace app {
+    UserDirectory::UserDirectory()
+        : byAddress_{ }, byUsername_{ }, byClientManager_{ }, mutex_{ } {
+        LOG_SCOPE;
+    }
+
+    bool UserDirectory::add(Connection connection, utils::Word ip, utils::HalfWord port, std::string username,
+                            std::optional<utils::UsernameRecord> &replaced) {
+        LOG_SCOPE;
+        WriteLock lock{ mutex_ };
+        auto const key = utils::makeAddressKey(ip, port);
+        auto const owner = byUsername_.find(username);
+        if (owner != std::end(byUsername_) && owner->second != key) {
+            return false;
+        }
+
+        replaced = removeLocked(connection.clientManager.get());
+        auto const previous = byAddress_.find(key);
+        if (!replaced && previous != std::end(byAddress_)) { // an old connection from the same address that isn't gone yet
+            replaced = removeLocked(previous->second.connection.clientManager.get());
+        }
+        byUsername_.emplace(username, key);
+
+        byClientManager_[connection.clientManager.get()] = key;
+        byAddress_[key] = Entry{ std::move(connection), std::move(username) };
+        return true;
+    }
+
+    std::optional<utils::UsernameRecord> UserDirectory::remove(ClientManager *clientManager) {
+        LOG_SCOPE;
+        WriteLock lock{ mutex_ };
+        return removeLocked(clientManager);
+    }
+
+    std::vector<utils::UsernameRecord> UserDirectory::getRecords() const {
+        LOG_SCOPE;
+        ReadLock lock{ mutex_ };
+        std::vector<utils::UsernameRecord> records{ };
+        records.reserve(byAddress_.size());
+        for (auto const &pair : byAddress_) {
+            records.push_back(makeRecord(pair.first, pair.second.username));
+        }
+        return records;
+    }
+
+    std::vector<Connection> UserDirectory::getConnections() const {
+        LOG_SCOPE;
+        ReadLock lock{ mutex_ };
+        std::vector<Connection> connections{ };
+        connections.reserve(byAddress_.size());
+        for (auto const &pair : byAddress_) {
+            connections.push_back(pair.second.connection);
+        }
+        return connections;
+    }
+
+    std::optional<Connection> UserDirectory::findByAddress(utils::Word ip, utils::HalfWord port) const {
+        LOG_SCOPE;
+        ReadLock lock{ mutex_ };
+        auto const it = byAddress_.find(utils::makeAddressKey(ip, port));
+        if (it == std::end(byAddress_)) {
+            return std::nullopt;
+        }
+        return it->second.connection;
+    }
+
+    std::optional<Connection> UserDirectory::findByUsername(std::string const &username) const {
+        LOG_SCOPE;
+        ReadLock lock{ mutex_ };
+        auto const it = byUsername_.find(username);
+        if (it == std::end(byUsername_)) {
+            return std::nullopt;
+        }
+        return byAddress_.at(it->second).connection;
+    }
+
+    std::size_t UserDirectory::size() const {
+        LOG_SCOPE;
+        ReadLock lock{ mutex_ };
+        return byAddress_.size();
+    }
+
+    utils::UsernameRecord UserDirectory::makeRecord(Key key, std::string const &username) {
+        LOG_SCOPE;
+        return utils::UsernameRecord{ utils::getIp(key), utils::getPort(key), static_cast<utils::Byte>(username.size()), username };
+    }
+
+    std::optional<utils::UsernameRecord> UserDirectory::removeLocked(ClientManager *clientManager) {
+        LOG_SCOPE;
+        auto const it = byClientManager_.find(clientManager);
+        if (it == std::end(byClientManager_)) {
+            return std::nullopt;
+        }
+
+        auto const entry = byAddress_.find(it->second);
+        if (entry == std::end(byAddress_) || entry->second.connection.clientManager.get() != clientManager) {
+            byClientManager_.erase(it); // a newer connection from the same address has the entry, it's not ours to remove
+            return std::nullopt;
+        }
+
+        auto record = makeRecord(entry->first, entry->second.username);
+        byUsername_.erase(entry->second.username);
+        byAddress_.erase(entry);
+        byClientManager_.erase(it);
+        return record;
+    }
+} // END of namespace app
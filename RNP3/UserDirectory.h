@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Types.h"
+
+class QThread;
+
+namespace app {
+    class ClientManager;
+    class Shard;
+
+    struct Connection final {
+        using this_type = Connection;
+        std::shared_ptr<ClientManager> clientManager; // a copy keeps the connection alive while another thread writes to it
+        Shard *shard; // nullptr if the server isn't sharded
+        QThread *thread; // the I/O thread the connection lives on, so nobody has to ask the connection itself
+    }; // END of struct Connection
+
+    // the logged in users. they can be looked up in constant time by the address they're connected from
+    // as well as by their username. lookups only take a shared lock, so the dispatching threads don't serialize on them.
+    class UserDirectory final {
+    public:
+        using this_type = UserDirectory;
+        using Mutex = std::shared_mutex;
+        using ReadLock = std::shared_lock<Mutex>;
+        using WriteLock = std::unique_lock<Mutex>;
+        using Key = utils::AddressKey;
+
+        UserDirectory();
+        UserDirectory(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+        // false if someone else has the name already, in which case nothing changes. logging in again renames the user;
+        // replaced gets the record that was there before, if there was one
+        bool add(Connection connection, utils::Word ip, utils::HalfWord port, std::string username,
+                 std::optional<utils::UsernameRecord> &replaced);
+        std::optional<utils::UsernameRecord> remove(ClientManager *clientManager); // returns the record of who was removed
+        std::vector<utils::UsernameRecord> getRecords() const; // the whole roster
+        std::vector<Connection> getConnections() const;
+        std::optional<Connection> findByAddress(utils::Word ip, utils::HalfWord port) const;
+        std::optional<Connection> findByUsername(std::string const &username) const;
+        std::size_t size() const;
+
+    private:
+        struct Entry final {
+            using this_type = Entry;
+            Connection connection;
+            std::string username;
+        }; // END of struct Entry
+
+        static utils::UsernameRecord makeRecord(Key key, std::string const &username);
+        std::optional<utils::UsernameRecord> removeLocked(ClientManager *clientManager);
+
+        std::unordered_map<Key, Entry> byAddress_;
+        std::unordered_map<std::string, Key> byUsername_;
+        std::unordered_map<ClientManager *, Key> byClientManager_;
+        mutable Mutex mutex_;
+    }; // END of class UserDirectory
+} // END of namespace app
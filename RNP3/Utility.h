@@ -2,6 +2,11 @@
 #include <cstdint>
 #include <type_traits>
 #include <cstddef>
+#include <tuple>
+#include <cstring>
+#ifdef _MSC_VER
+#   include <stdlib.h>
+#endif
 
 namespace utils {
     using Byte = std::uint8_t;
@@ -27,6 +32,27 @@ namespace utils {
 
     } // END of namespace detail
 
+    template <class... Types>
+    struct type_list final {
+        using this_type = type_list;
+        static std::size_t constexpr size = sizeof...(Types);
+
+        template <template <class...> class Template>
+        using apply = Template<Types...>; // e.g. type_list<A, B>::apply<std::variant> is std::variant<A, B>
+    }; // END of struct type_list
+
+    template <std::size_t Index, class TypeList>
+    struct type_at;
+
+    template <std::size_t Index, class... Types>
+    struct type_at<Index, type_list<Types...>> final {
+        using this_type = type_at;
+        using type = std::tuple_element_t<Index, std::tuple<Types...>>;
+    }; // END of struct type_at
+
+    template <std::size_t Index, class TypeList>
+    using type_at_t = typename type_at<Index, TypeList>::type;
+
     template <class Pointer>
     void advancePtr(Pointer &pointer, std::size_t advanceBy) {
         static_assert(std::is_pointer_v<std::remove_reference_t<Pointer>>, "Pointer in advancePtr was not a pointer");
@@ -36,18 +62,79 @@ namespace utils {
         pointer = reinterpret_cast<Pointer>(bytePtr);
     }
 
-    template <class TypeToRead, class Pointer>
-    TypeToRead readFromAddress(Pointer &&pointer) {
-        static_assert(std::is_pointer_v<std::remove_reference_t<Pointer>>, "Pointer in readFromAddress was not a pointer");
-        auto p = reinterpret_cast<TypeToRead const *>(pointer);
-        return *p;
+    namespace detail {
+        template <class Type, bool = std::is_enum_v<Type>>
+        struct wire_bits final { // the unsigned integer a field goes over the wire as
+            using this_type = wire_bits;
+            using type = std::make_unsigned_t<Type>;
+        }; // END of struct wire_bits
+
+        template <class Type>
+        struct wire_bits<Type, true> final {
+            using this_type = wire_bits;
+            using type = std::make_unsigned_t<std::underlying_type_t<Type>>;
+        }; // END of struct wire_bits
+
+        template <class Type>
+        using wire_bits_t = typename wire_bits<Type>::type;
+
+        template <class Unsigned>
+        Unsigned byteSwap(Unsigned value) {
+            static_assert(std::is_unsigned_v<Unsigned>, "Unsigned in byteSwap was not an unsigned integer");
+            if constexpr (sizeof(Unsigned) == 1U) {
+                return value;
+            } else if constexpr (sizeof(Unsigned) == 2U) {
+#ifdef _MSC_VER
+                return _byteswap_ushort(value);
+#else
+                return __builtin_bswap16(value);
+#endif
+            } else if constexpr (sizeof(Unsigned) == 4U) {
+#ifdef _MSC_VER
+                return _byteswap_ulong(value);
+#else
+                return __builtin_bswap32(value);
+#endif
+            } else {
+                static_assert(sizeof(Unsigned) == 8U, "byteSwap only knows 1, 2, 4 and 8 byte integers");
+#ifdef _MSC_VER
+                return _byteswap_uint64(value);
+#else
+                return __builtin_bswap64(value);
+#endif
+            }
+        }
+    } // END of namespace detail
+
+#if defined(_MSC_VER) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    static bool constexpr isLittleEndianHost = true;
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    static bool constexpr isLittleEndianHost = false;
+#else
+#   error "couldn't tell the byte order of the target"
+#endif
+
+    // the protocol's integers are big endian (network byte order) and sit at any offset in the receive buffer.
+    // memcpy makes the unaligned access well defined everywhere and still compiles down to a single load or store.
+    template <class Type>
+    Type loadBigEndian(void const *address) {
+        static_assert(std::is_integral_v<Type> || std::is_enum_v<Type>, "Type in loadBigEndian was not an integer or enum");
+        detail::wire_bits_t<Type> bits;
+        std::memcpy(&bits, address, sizeof(bits));
+        if constexpr (isLittleEndianHost) {
+            bits = detail::byteSwap(bits);
+        }
+        return static_cast<Type>(bits);
     }
 
-    template <class TypeToWrite, class Pointer>
-    void writeToAddress(Pointer pointer, TypeToWrite value) {
-        static_assert(std::is_pointer_v<std::remove_reference_t<Pointer>>, "Pointer in writeToAddress was not a pointer");
-        auto p = reinterpret_cast<TypeToWrite *>(pointer);
-        *p = value;
+    template <class Type>
+    void storeBigEndian(void *address, Type value) {
+        static_assert(std::is_integral_v<Type> || std::is_enum_v<Type>, "Type in storeBigEndian was not an integer or enum");
+        auto bits = static_cast<detail::wire_bits_t<Type>>(value);
+        if constexpr (isLittleEndianHost) {
+            bits = detail::byteSwap(bits);
+        }
+        std::memcpy(address, &bits, sizeof(bits));
     }
     
 } // END of namespace utils
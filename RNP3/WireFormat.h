@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include "Utility.h"
+#include "Types.h"
+
+namespace utils {
+    // the fixed size parts of the protocol, described field by field. the offsets and sizes follow from the field types
+    // at compile time, and every load and store goes through loadBigEndian/storeBigEndian, so the encoders and decoders
+    // are generated from the description instead of being written out by hand with pointer arithmetic.
+    template <class... Fields>
+    struct WireLayout {
+        using this_type = WireLayout;
+        using fields = type_list<Fields...>;
+        using tuple_type = std::tuple<Fields...>;
+
+        static std::size_t constexpr byteSize = (sizeof(Fields) + ... + 0U);
+
+        template <std::size_t Index>
+        using field_type = type_at_t<Index, fields>;
+
+        template <std::size_t Index>
+        static constexpr std::size_t offsetOf() {
+            std::size_t const sizes[] = { sizeof(Fields)... };
+            std::size_t offset = 0U;
+            for (std::size_t i = 0U; i < Index; ++i) {
+                offset += sizes[i];
+            }
+            return offset;
+        }
+
+        template <std::size_t Index>
+        static field_type<Index> load(void const *record) {
+            return loadBigEndian<field_type<Index>>(static_cast<char const *>(record) + offsetOf<Index>());
+        }
+
+        template <std::size_t Index>
+        static void store(void *record, field_type<Index> value) {
+            storeBigEndian(static_cast<char *>(record) + offsetOf<Index>(), value);
+        }
+
+        static tuple_type loadAll(void const *record) { // the fields are next to each other, so the loads may merge
+            return loadAll(record, std::index_sequence_for<Fields...>{ });
+        }
+
+        static char *storeAll(char *record, Fields... values) { // returns one past the record
+            storeAll(record, std::index_sequence_for<Fields...>{ }, values...);
+            return record + byteSize;
+        }
+
+    private:
+        template <std::size_t... Indices>
+        static tuple_type loadAll(void const *record, std::index_sequence<Indices...>) {
+            return tuple_type{ load<Indices>(record)... };
+        }
+
+        template <std::size_t... Indices>
+        static void storeAll(char *record, std::index_sequence<Indices...>, Fields... values) {
+            (store<Indices>(record, values), ...);
+        }
+    }; // END of struct WireLayout
+
+    namespace wire {
+        struct CommonHeader final : WireLayout<Word, MessageType, Word> {
+            using this_type = CommonHeader;
+            enum : std::size_t { version, type, length };
+        }; // END of struct CommonHeader
+
+        struct SendMsgStruct final : WireLayout<Word, Word, Word, HalfWord, HalfWord> {
+            using this_type = SendMsgStruct;
+            enum : std::size_t { messageId, sourceIp, targetIp, sourcePort, targetPort };
+        }; // END of struct SendMsgStruct
+
+        struct UsernameRecord final : WireLayout<Word, HalfWord, Byte, Byte> { // followed by the padded username
+            using this_type = UsernameRecord;
+            enum : std::size_t { ip, port, lengthUsername, reserved };
+        }; // END of struct UsernameRecord
+
+        struct ClientListDelta final : WireLayout<Word, Word, Word> { // followed by the added and then the removed records
+            using this_type = ClientListDelta;
+            enum : std::size_t { baseVersion, rosterVersion, amtAdded };
+        }; // END of struct ClientListDelta
+
+        static_assert(CommonHeader::byteSize == commonHeaderByteSize, "the common header layout doesn't match commonHeaderByteSize");
+        static_assert(SendMsgStruct::byteSize == sendMsgStructByteSize, "the send message layout doesn't match sendMsgStructByteSize");
+        static_assert(UsernameRecord::byteSize == usernameRecordStaticByteSize,
+                      "the username record layout doesn't match usernameRecordStaticByteSize");
+        static_assert(ClientListDelta::byteSize == clientListDeltaStaticByteSize,
+                      "the client list delta layout doesn't match clientListDeltaStaticByteSize");
+    } // END of namespace wire
+} // END of namespace utils
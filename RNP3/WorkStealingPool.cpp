@@ -0,0 +1,138 @@
+#include "WorkStealingPool.h"
+#include <exception>
+#include <utility>
+#include "Logger.h"
+
+namespace utils {
+    namespace {
+        thread_local WorkStealingPool *currentPool = nullptr; // the pool the calling thread works for, if any
+        thread_local std::size_t currentWorker = 0U;
+    } // END of anonymous namespace
+
+    WorkStealingPool::WorkStealingPool(int threadCount)
+        : nextWorker_{ 0U }, pendingTasks_{ 0U }, stealCount_{ 0U }, isStopping_{ false } {
+        LOG_SCOPE;
+        for (auto i = 0; i < threadCount; ++i) {
+            workers_.push_back(std::make_unique<Worker>());
+        }
+        for (std::size_t i = 0U; i < workers_.size(); ++i) {
+            threads_.emplace_back(&this_type::run, this, i);
+        }
+        LOG_DEBUG << "WorkStealingPool: started " << threadCount << " workers\n";
+    }
+
+    WorkStealingPool::~WorkStealingPool() {
+        LOG_SCOPE;
+        stop();
+    }
+
+    void WorkStealingPool::submit(Task task) {
+        LOG_SCOPE;
+        // held until the task is counted, so a worker that is about to sleep or leave has either seen it or is waiting by now
+        Lock sleepLock{ sleepMutex_ };
+        if (workers_.empty() || isStopping_) { // nobody would ever run it, and whoever submitted it may be waiting for it
+            sleepLock.unlock();
+            execute(task);
+            return;
+        }
+
+        auto const index = currentPool == this ? currentWorker
+                                               : nextWorker_.fetch_add(1U) % workers_.size();
+        {
+            Lock lock{ workers_[index]->mutex };
+            workers_[index]->tasks.push_back(std::move(task));
+        }
+        ++pendingTasks_;
+        sleepLock.unlock();
+        wakeUp_.notify_one();
+    }
+
+    void WorkStealingPool::stop() {
+        LOG_SCOPE;
+        {
+            Lock lock{ sleepMutex_ };
+            isStopping_ = true;
+        }
+        wakeUp_.notify_all();
+        for (auto &thread : threads_) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+    }
+
+    int WorkStealingPool::size() const {
+        LOG_SCOPE;
+        return static_cast<int>(workers_.size());
+    }
+
+    std::size_t WorkStealingPool::getStealCount() const {
+        LOG_SCOPE;
+        return stealCount_;
+    }
+
+    void WorkStealingPool::run(std::size_t index) {
+        LOG_SCOPE;
+        currentPool = this;
+        currentWorker = index;
+        for (;;) {
+            auto task = popLocal(index);
+            if (!task) {
+                task = steal(index);
+            }
+
+            if (task) {
+                --pendingTasks_;
+                execute(*task);
+                continue;
+            }
+
+            Lock lock{ sleepMutex_ };
+            if (isStopping_ && pendingTasks_ == 0U) {
+                return;
+            }
+            wakeUp_.wait(lock, [this] {
+                return pendingTasks_ > 0U || isStopping_;
+            });
+        }
+    }
+
+    void WorkStealingPool::execute(Task &task) {
+        LOG_SCOPE;
+        try {
+            task();
+        } catch (std::exception const &ex) {
+            LOG_ERROR << "Caught exception in WorkStealingPool::execute:\n" << ex.what() << '\n';
+        } catch (...) {
+            LOG_ERROR << "Unknown exception caught in WorkStealingPool::execute\n";
+        }
+    }
+
+    std::optional<WorkStealingPool::Task> WorkStealingPool::popLocal(std::size_t index) {
+        LOG_SCOPE;
+        auto &worker = *workers_[index];
+        Lock lock{ worker.mutex };
+        if (worker.tasks.empty()) {
+            return std::nullopt;
+        }
+        auto task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        return task;
+    }
+
+    std::optional<WorkStealingPool::Task> WorkStealingPool::steal(std::size_t thief) {
+        LOG_SCOPE;
+        for (std::size_t i = 1U; i < workers_.size(); ++i) {
+            auto &victim = *workers_[(thief + i) % workers_.size()];
+            Lock lock{ victim.mutex, std::try_to_lock }; // a busy victim is skipped rather than waited for
+            if (!lock.owns_lock() || victim.tasks.empty()) {
+                continue;
+            }
+            auto task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            ++stealCount_;
+            return task;
+        }
+        return std::nullopt;
+    }
+} // END of namespace utils
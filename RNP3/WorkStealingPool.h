@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace utils {
+    // a fixed set of worker threads, each with its own deque of tasks.
+    // a worker runs its own tasks newest first and, once it has run dry, steals the oldest task of another worker,
+    // so a burst that was submitted to one worker ends up spread over all of them.
+    // the pool doesn't order tasks; whoever needs ordering has to make sure only one of its tasks is queued at a time.
+    class WorkStealingPool final {
+    public:
+        using this_type = WorkStealingPool;
+        using Task = std::function<void()>;
+        using Mutex = std::mutex;
+        using Lock = std::unique_lock<Mutex>;
+
+        explicit WorkStealingPool(int threadCount); // a threadCount of 0 gives a pool that runs every task right away
+        WorkStealingPool(this_type const &) = delete;
+        this_type &operator=(this_type const &) = delete;
+        ~WorkStealingPool();
+        void submit(Task task); // may be called from any thread, the workers included; once stopped, it runs the task itself
+        void stop(); // runs the tasks that are already queued, then joins the workers
+        int size() const;
+        std::size_t getStealCount() const;
+
+    private:
+        struct Worker final {
+            std::deque<Task> tasks; // the owner works at the back, thieves take from the front
+            Mutex mutex;
+        }; // END of struct Worker
+
+        void run(std::size_t index);
+        void execute(Task &task);
+        std::optional<Task> popLocal(std::size_t index);
+        std::optional<Task> steal(std::size_t thief);
+
+        std::vector<std::unique_ptr<Worker>> workers_;
+        std::vector<std::thread> threads_;
+        std::atomic<std::size_t> nextWorker_; // where tasks from outside the pool go, round robin
+        std::atomic<std::size_t> pendingTasks_;
+        std::atomic<std::size_t> stealCount_;
+        std::atomic_bool isStopping_;
+        Mutex sleepMutex_;
+        std::condition_variable wakeUp_;
+    }; // END of class WorkStealingPool
+} // END of namespace utils
@@ -1,22 +1,29 @@
 ﻿#include "client.hpp"
 #include <QTextEdit>
 #include "Types.h"
+#include "Frame.h"
+#include "MessageViews.h"
 #include "Logger.h"
 #include <functional>
 #include <utility>
-#include "functions.h"
+#include "FrameAssembler.h"
 #include "Types.h"
 #include "Other.h"
+#include "HeartbeatMonitor.h"
 
 namespace app {
     Client::Client(QString hostToConnectTo, qint16 port, QObject *parent)
         : Base{ parent },
           port_{ port },
-          hostToConnectTo_{ std::move(hostToConnectTo) } {
+          hostToConnectTo_{ std::move(hostToConnectTo) },
+          roster_{ },
+          rosterVersion_{ utils::UpdateClientListDeltaMessage::fullRoster },
+          isRosterRequested_{ false } {
 
         LOG_SCOPE;
-        connect(this, SIGNAL(gotResponseSignal(utils::Message *)),
-                this, SLOT(responseSlot(utils::Message *)), Qt::QueuedConnection);
+        qRegisterMetaType<utils::Frame>("utils::Frame");
+        connect(this, SIGNAL(gotResponseSignal(utils::Frame)),
+                this, SLOT(responseSlot(utils::Frame)), Qt::QueuedConnection);
 
         auto f = std::bind(&this_type::clientThreadFunction, this);
         workerThread_ = std::async(std::launch::async, std::move(f)); {
@@ -35,72 +42,78 @@ namespace app {
     }
 
     void Client::writeToSocket(QByteArray data) {
-        qDataStream_.writeBytes(data.constData(), data.size());
+        qDataStream_.writeRawData(data.constData(), data.size()); // the frames carry their own lengths
     }
 
-    void Client::responseSlot(utils::Message *msg) {
+    void Client::responseSlot(utils::Frame frame) {
         auto clientManager = qobject_cast<Client *>(sender());
         if (clientManager == nullptr) {
             LOG_ERROR << "downcast in Client::responseSlot failed\n";
             return;
         }
 
-        auto finalAction = utils::finally([msg] {
-                                              delete msg;
-                                          });
-
-        std::type_index typeIndex{ typeid(*msg) };
-        auto it = utils::rttiTable.find(typeIndex);
-        if (it == std::end(utils::rttiTable)) {
-            throw std::logic_error{ "typeIndex not found in rttiTable in IncomingMessageHandler::readyReadSlot" };
-
-        } // TODO: make it so that you can wirte to this socket
-        auto messageType = it->second;
-        switch (messageType) { // TODO: respond to messages, emit signal with new string to display chat msgs
-            case utils::MessageType::reqFindServer : {
-                auto p = static_cast<utils::ReqFindServerMessage *>(msg);
-                break;
-            }
-            case utils::MessageType::resFindServer : {
-                auto p = static_cast<utils::ResFindServerMessage *>(msg);
-                break;
-            }
-            case utils::MessageType::reqLogin : {
-                auto p = static_cast<utils::ReqLoginMessage *>(msg);
-                break;
-            }
-            case utils::MessageType::updateClientList : {
-                auto p = static_cast<utils::UpdateClientListMessage *>(msg);
-                break;
-            }
-            case utils::MessageType::sendMsgGrp : {
-                auto p = static_cast<utils::SendMsgGrpMessage *>(msg);
-                break;
-            }
-            case utils::MessageType::sendMsgUsr : {
-                auto p = static_cast<utils::SendMsgUsrMessage *>(msg);
-                emit printMsgSignal(QString::fromStdString(p->getMessageText())); //TODO: add username
-                break;
-            }
-            case utils::MessageType::reqHeartbeat : {
-                auto p = static_cast<utils::ReqHeartbeatMessage *>(msg);
-                break;
-            }
-            case utils::MessageType::resHeartbeat : {
-                auto p = static_cast<utils::ResHeartbeatMessage *>(msg);
-                break;
+        // TODO: make it so that you can wirte to this socket
+        utils::visitFrame(std::move(frame), [this](auto const &view) {
+            handle(view);
+        });
+    } // END Client::responseSlot
+
+    void Client::handle(utils::SendMsgGrpView const &view) {
+        LOG_SCOPE;
+        auto const text = view.getMessageText();
+        emit printMsgSignal(QString::fromUtf8(text.data(), static_cast<int>(text.size()))); //TODO: add username
+    }
+
+    void Client::handle(utils::SendMsgUsrView const &view) {
+        LOG_SCOPE;
+        auto const text = view.getMessageText();
+        emit printMsgSignal(QString::fromUtf8(text.data(), static_cast<int>(text.size()))); //TODO: add username
+    }
+
+    void Client::handle(utils::ErrorMsgNotDeliveredView const &/*view*/) {
+        LOG_SCOPE;
+        emit printMsgSignal(QString{ "The message couldn't be delivered, the user isn't logged in anymore." });
+    }
+
+    void Client::handle(utils::UpdateClientListDeltaView const &view) {
+        LOG_SCOPE;
+        auto const key = [](utils::UsernameRecordView const &record) {
+            return utils::makeAddressKey(record.getIp(), record.getPort());
+        };
+
+        if (view.isFullRoster()) {
+            roster_.clear();
+            isRosterRequested_ = false;
+        } else if (view.getBaseVersion() != rosterVersion_) { // missed a delta, the roster can't be patched anymore
+            if (!isRosterRequested_) {
+                isRosterRequested_ = true;
+                utils::ReqClientListMessage const request{ utils::protocolVersion, utils::MessageType::reqClientList, 0U };
+                writeToSocket(request.toByteArray());
             }
-            case utils::MessageType::errorMsgNotDelivered : {
-                auto p = static_cast<utils::ErrorMsgNotDeliveredMessage *>(msg);
-                break;
+            return;
+        } else {
+            for (auto it = view.removedBegin(), end = view.removedEnd(); it != end; ++it) {
+                roster_.erase(key(*it));
             }
-            default : throw std::logic_error{ "unrecognized MessageType in Client::responseSlot" };
-        } // END switch (messageType)
-    } // END Client::responseSlot
+        }
+
+        for (auto it = view.addedBegin(), end = view.addedEnd(); it != end; ++it) {
+            auto const record = *it;
+            roster_[key(record)] = std::string{ record.getUsername() };
+        }
+        rosterVersion_ = view.getRosterVersion();
+    }
+
+    void Client::handle(utils::ReqHeartbeatView const &/*view*/) {
+        LOG_SCOPE;
+        auto const &response = HeartbeatMonitor::responseFrame();
+        writeToSocket(QByteArray::fromRawData(response.data(), static_cast<int>(response.size())));
+    }
 
     void Client::clientThreadFunction() {
         LOG_SCOPE;
         QTcpSocket socket{ };
+        func::FrameAssembler assembler{ };
         socket.connectToHost(hostToConnectTo_, port_);
         {
             Lock lock{ initMutex_ };
@@ -119,14 +132,19 @@ namespace app {
             if (!isThreadRunning_) {
                 return;
             }
-            socket.waitForReadyRead(3000);
-            if (socket.bytesAvailable() < 1) {
-                continue;
+            // the server makes sure we're still there with its heartbeats; all this wait decides is how soon we notice
+            // that the client is being shut down. an idle connection the server has closed ends the thread.
+            if (!socket.waitForReadyRead(3000) && socket.state() != QAbstractSocket::ConnectedState) {
+                LOG_WARNING << "Client.cpp clientThreadFunction, the server closed the connection\n";
+                return;
             }
             try {
-                auto msg = func::makeMessage(socket);
-                emit gotResponseSignal(msg.release());
-                // TODO: emit message 
+                if (assembler.readFrom(socket) == 0) {
+                    continue;
+                }
+                while (auto frame = assembler.takeFrame()) {
+                    emit gotResponseSignal(std::move(*frame));
+                }
             } catch (std::logic_error const &ex) {
                 LOG_DEBUG << "Caught std::logic_error in Client::clientThreadFunction() :\n" << ex.what() << '\n';
             } catch (...) {
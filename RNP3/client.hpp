@@ -6,9 +6,22 @@
 #include <mutex>
 #include <condition_variable>
 #include <QDataStream>
+#include <map>
+#include <string>
+#include <cstdint>
+#include "Utility.h"
+#include "Types.h"
 
 namespace utils {
-    class Message;
+    class Frame;
+    class UpdateClientListDeltaView;
+    class SendMsgGrpView;
+    class SendMsgUsrView;
+    class ErrorMsgNotDeliveredView;
+    class ReqHeartbeatMessage;
+    template <class MessageT>
+    class HeaderOnlyView;
+    using ReqHeartbeatView = HeaderOnlyView<ReqHeartbeatMessage>;
 }
 
 namespace app {
@@ -20,6 +33,7 @@ namespace app {
         using Base = QObject;
         using Mutex = std::mutex;
         using Lock = std::unique_lock<Mutex>;
+        using Roster = std::map<utils::AddressKey, std::string>; // the logged in users by ip and port
 
         explicit Client(QString hostToConnectTo, qint16 port, QObject *parent = nullptr);
         ~Client();
@@ -27,14 +41,25 @@ namespace app {
         void writeToSocket(QByteArray data);
 
     private slots:
-        void responseSlot(utils::Message *);
+        void responseSlot(utils::Frame);
 
     signals:
-        void gotResponseSignal(utils::Message *);
+        void gotResponseSignal(utils::Frame);
         void printMsgSignal(QString);
 
     private:
         void clientThreadFunction();
+        void handle(utils::SendMsgGrpView const &view);
+        void handle(utils::SendMsgUsrView const &view);
+        void handle(utils::UpdateClientListDeltaView const &view); // applies the delta to roster_
+        void handle(utils::ReqHeartbeatView const &view); // the server checking whether we're still there
+        void handle(utils::ErrorMsgNotDeliveredView const &view);
+
+        // the requests (ReqFindServer, ReqLogin, ReqClientList) only ever go from a client to a server. the server
+        // doesn't send UpdateClientList anymore, it sends deltas, and ResFindServer and ResHeartbeat answer requests
+        // this client never makes.
+        template <class View>
+        void handle(View const &/*view*/) { }
 
         std::future<void> workerThread_;
         QDataStream qDataStream_;
@@ -44,5 +69,8 @@ namespace app {
         std::atomic_bool isThreadRunning_;
         qint16 port_;
         QString hostToConnectTo_;
+        Roster roster_;
+        utils::Word rosterVersion_;
+        bool isRosterRequested_; // a delta went missing and the full roster has been asked for
     }; // END of class Client
 } // END of namespace app
@@ -1,13 +1,16 @@
 #include "functions.h"
 #include <array>
 #include <utility>
-#include <QByteArray>
+#include <stdexcept>
 #include "Types.h"
-#include <thread>
-#include <chrono>
+#include "WireFormat.h"
 #include "Logger.h"
+#include "Metrics.h"
 
 namespace {
+    using func::DecodeStatus;
+    using func::FrameScan;
+
     struct CommonHeader final {
         using this_type = CommonHeader;
         utils::Word version;
@@ -24,193 +27,293 @@ namespace {
         utils::HalfWord targetPort;
     }; // END of struct SendMsgStruct
 
-    QByteArray readFromSocket(int bytesToRead, QTcpSocket &socket) {
-        LOG_SCOPE;
-        LOG_DEBUG << "readFromSocket: " << bytesToRead << " bytesToRead\n";
-        if (bytesToRead < 1) {
-            throw std::logic_error{ "readFromSocket: bytesToRead was < 1\n" };
-        }
-        QByteArray ret{ bytesToRead, '\0' };
-        auto c = '\0';
-        if (socket.bytesAvailable() < bytesToRead) {
-            std::this_thread::sleep_for(std::chrono::seconds{ 3 });
-        }
-
-        if (socket.bytesAvailable() < bytesToRead) {
-            throw std::logic_error{ "client didn't send enough data, after 3 seconds still no data - too bad.\n" };
-        }
-
-        for (auto i = 0; i < bytesToRead; ++i) {
-            if (!socket.getChar(&c)) {
-                LOG_WARNING << "failed to read a byte in readFromSocket\n";
-                continue;
-            }
+    static auto constexpr maxiMumUserNameLength = 255;
 
-            ret[i] = c;
-        }
-        return ret;
-    }
-
-    std::string readString(char const *begin, utils::Word length) {
+    CommonHeader readCommonHeader(void const *pData) {
         LOG_SCOPE;
-        std::string str(length + 1, '\0');
-        auto end = begin;
-        utils::advancePtr(end, length);
-        std::copy(begin, end, std::begin(str));
-        return str;
+        auto const [version, type, length] = utils::wire::CommonHeader::loadAll(pData);
+        return CommonHeader{ version, type, length };
     }
 
-    std::unique_ptr<utils::Message> makeReqFindServerMessage(CommonHeader commonHeader, QTcpSocket &/*socket*/) {
+    std::string readString(char const *begin, utils::Word length) {
         LOG_SCOPE;
-        return std::make_unique<utils::ReqFindServerMessage>(commonHeader.version, commonHeader.type, commonHeader.length);
+        return std::string(begin, length);
     }
 
-    std::unique_ptr<utils::Message> makeResFindServerMessage(CommonHeader commonHeader, QTcpSocket &/*socket*/) {
+    // decodes the body following the common header. messages that are nothing but the common header use this one as it is
+    template <class MessageT>
+    MessageT decode(CommonHeader commonHeader, void const */*pData*/) {
         LOG_SCOPE;
-        return std::make_unique<utils::ResFindServerMessage>(commonHeader.version, commonHeader.type, commonHeader.length);
+        return MessageT{ commonHeader.version, commonHeader.type, commonHeader.length };
     }
 
-    std::unique_ptr<utils::Message> makeReqLoginMessage(CommonHeader commonHeader, QTcpSocket &socket) {
+    template <>
+    utils::ReqLoginMessage decode<utils::ReqLoginMessage>(CommonHeader commonHeader, void const *pData) {
         LOG_SCOPE;
-        static auto constexpr maxiMumUserNameLength = 255;
-        if (commonHeader.length > maxiMumUserNameLength) {
-            throw std::logic_error{ "length was too large in makeReqLoginMessage" };
-        }
-        
-        auto bytes = readFromSocket(commonHeader.length, socket);
-        void const *pData = bytes.constData();
-
         auto username = readString(static_cast<char const *>(pData), commonHeader.length);
-
-        return std::make_unique<utils::ReqLoginMessage>(commonHeader.version, commonHeader.type, commonHeader.length, std::move(username));
+        return utils::ReqLoginMessage{ commonHeader.version, commonHeader.type, commonHeader.length, std::move(username) };
     }
 
-    utils::UsernameRecord readUsernameRecord(QTcpSocket &socket) {
+    utils::UsernameRecord readUsernameRecord(void const *&pData) {
         LOG_SCOPE;
-        static auto constexpr cbStaticComponent = sizeof(utils::Word) + sizeof(utils::HalfWord) + sizeof(utils::Byte) * 2;
-
-        auto bytes = readFromSocket(cbStaticComponent, socket);
-        void const *pData = bytes.constData();
-
-        auto ip = utils::readFromAddress<utils::Word>(pData);
-        utils::advancePtr(pData, sizeof(utils::Word));
-
-        auto port = utils::readFromAddress<utils::HalfWord>(pData);
-        utils::advancePtr(pData, sizeof(utils::HalfWord));
-
-        auto lengthUserName = utils::readFromAddress<utils::Byte>(pData);
-        utils::advancePtr(pData, sizeof(utils::Byte));
-
-        static auto constexpr maxiMumUserNameLength = 255;
-        if (lengthUserName > maxiMumUserNameLength) {
-            throw std::logic_error{ "lengthUserName was too large in readUsernameRecord" };
-        }
-
-        utils::advancePtr(pData, sizeof(utils::Byte)); // skip the reserved part
-
-        auto const additionalBytesToRead = utils::bitAlignment - lengthUserName % utils::bitAlignment;
-        auto const totalBytesToRead = lengthUserName + additionalBytesToRead;
-        if (totalBytesToRead % utils::bitAlignment != 0) {
-            throw std::logic_error{ "totalBytesToRead was not a multiple of 32 in readUsernameRecord" };
-        }
-
-        bytes = readFromSocket(totalBytesToRead, socket);
-        pData = bytes.constData();
+        [[maybe_unused]] auto const [ip, port, lengthUserName, reserved] = utils::wire::UsernameRecord::loadAll(pData);
+        utils::advancePtr(pData, utils::wire::UsernameRecord::byteSize);
 
         auto username = readString(static_cast<char const *>(pData), lengthUserName);
-        utils::advancePtr(pData, lengthUserName);
-
-        for (; reinterpret_cast<std::ptrdiff_t>(pData) % utils::bitAlignment; utils::advancePtr(pData, sizeof(utils::Byte))) { }
+        utils::advancePtr(pData, utils::paddedUsernameLength(lengthUserName)); // skip the name and its padding
 
         return utils::UsernameRecord{ ip, port, lengthUserName, std::move(username) };
     }
 
-    std::unique_ptr<utils::Message> makeUpdateClientListMessage(CommonHeader commonHeader, QTcpSocket &socket) {
+    template <>
+    utils::UpdateClientListMessage decode<utils::UpdateClientListMessage>(CommonHeader commonHeader, void const *pData) {
         LOG_SCOPE;
         std::vector<utils::UsernameRecord> v{ };
+        v.reserve(commonHeader.length); // frameSize already made sure that all the records are there
         for (auto i = static_cast<utils::Word>(0U); i < commonHeader.length; ++i) {
-            v.push_back(readUsernameRecord(socket));
+            v.push_back(readUsernameRecord(pData));
         }
-        return std::make_unique<utils::UpdateClientListMessage>(commonHeader.version, commonHeader.type, commonHeader.length, std::move(v));
+        return utils::UpdateClientListMessage{ commonHeader.version, commonHeader.type, commonHeader.length, std::move(v) };
     }
 
-    SendMsgStruct makeSendMsgStruct(QTcpSocket &socket) {
+    template <>
+    utils::UpdateClientListDeltaMessage decode<utils::UpdateClientListDeltaMessage>(CommonHeader commonHeader, void const *pData) {
         LOG_SCOPE;
-        auto bytes = readFromSocket(utils::sendMsgStructByteSize, socket);
-        void const *pData = bytes.constData();
-        auto messageId = utils::readFromAddress<utils::Word>(pData);
-        utils::advancePtr(pData, sizeof(utils::Word));
-        auto sourceIp = utils::readFromAddress<utils::Word>(pData);
-        utils::advancePtr(pData, sizeof(utils::Word));
-        auto targetIp = utils::readFromAddress<utils::Word>(pData);
-        utils::advancePtr(pData, sizeof(utils::Word));
-        auto sourePort = utils::readFromAddress<utils::HalfWord>(pData);
-        utils::advancePtr(pData, sizeof(utils::HalfWord));
-        auto targetPort = utils::readFromAddress<utils::HalfWord>(pData);
-        utils::advancePtr(pData, sizeof(utils::HalfWord));
-        return SendMsgStruct{ messageId, sourceIp, targetIp, sourePort, targetPort };
+        auto const [baseVersion, rosterVersion, amtAdded] = utils::wire::ClientListDelta::loadAll(pData);
+        utils::advancePtr(pData, utils::wire::ClientListDelta::byteSize);
+
+        std::vector<utils::UsernameRecord> added{ };
+        added.reserve(amtAdded);
+        for (auto i = static_cast<utils::Word>(0U); i < amtAdded; ++i) {
+            added.push_back(readUsernameRecord(pData));
+        }
+        std::vector<utils::UsernameRecord> removed{ };
+        removed.reserve(commonHeader.length - amtAdded); // frameSize made sure that amtAdded doesn't exceed the length
+        for (auto i = amtAdded; i < commonHeader.length; ++i) {
+            removed.push_back(readUsernameRecord(pData));
+        }
+        return utils::UpdateClientListDeltaMessage{ commonHeader.version, commonHeader.type, commonHeader.length,
+                                                    baseVersion, rosterVersion, std::move(added), std::move(removed) };
+    }
+
+    SendMsgStruct makeSendMsgStruct(void const *&pData) {
+        LOG_SCOPE;
+        auto const [messageId, sourceIp, targetIp, sourcePort, targetPort] = utils::wire::SendMsgStruct::loadAll(pData);
+        utils::advancePtr(pData, utils::wire::SendMsgStruct::byteSize);
+        return SendMsgStruct{ messageId, sourceIp, targetIp, sourcePort, targetPort };
     }
 
     template <class RunTimeType>
-    std::unique_ptr<utils::Message> makeSendMessage(CommonHeader commonHeader, QTcpSocket &socket) {
+    RunTimeType makeSendMessage(CommonHeader commonHeader, void const *pData) {
         LOG_SCOPE;
-        auto sendMsgStruct = makeSendMsgStruct(socket);
+        auto sendMsgStruct = makeSendMsgStruct(pData);
         auto messageTextStringLength = commonHeader.length - utils::sendMsgStructByteSize;
-        auto bytes = readFromSocket(messageTextStringLength, socket);
-        void const *pData = bytes.constData();
         auto messageTextString = readString(static_cast<char const *>(pData), messageTextStringLength);
-        return std::make_unique<RunTimeType>(commonHeader.version, commonHeader.type, commonHeader.length, sendMsgStruct.messageId, sendMsgStruct.sourceIp, sendMsgStruct.targetIp, sendMsgStruct.sourcePort, sendMsgStruct.targetPort, std::move(messageTextString));
+        return RunTimeType{ commonHeader.version, commonHeader.type, commonHeader.length, sendMsgStruct.messageId, sendMsgStruct.sourceIp, sendMsgStruct.targetIp, sendMsgStruct.sourcePort, sendMsgStruct.targetPort, std::move(messageTextString) };
+    }
+
+    template <>
+    utils::SendMsgGrpMessage decode<utils::SendMsgGrpMessage>(CommonHeader commonHeader, void const *pData) {
+        LOG_SCOPE;
+        return makeSendMessage<utils::SendMsgGrpMessage>(commonHeader, pData);
+    }
+
+    template <>
+    utils::SendMsgUsrMessage decode<utils::SendMsgUsrMessage>(CommonHeader commonHeader, void const *pData) {
+        LOG_SCOPE;
+        return makeSendMessage<utils::SendMsgUsrMessage>(commonHeader, pData);
     }
 
-    std::unique_ptr<utils::Message> makeSendMsgGrpMessage(CommonHeader commonHeader, QTcpSocket &socket) {
+    template <>
+    utils::ErrorMsgNotDeliveredMessage decode<utils::ErrorMsgNotDeliveredMessage>(CommonHeader commonHeader, void const *pData) {
         LOG_SCOPE;
-        return makeSendMessage<utils::SendMsgGrpMessage>(commonHeader, socket);
+        auto sendMsgStruct = makeSendMsgStruct(pData);
+        return utils::ErrorMsgNotDeliveredMessage{ commonHeader.version, commonHeader.type, commonHeader.length, sendMsgStruct.messageId, sendMsgStruct.sourceIp, sendMsgStruct.targetIp, sendMsgStruct.sourcePort, sendMsgStruct.targetPort };
     }
 
-    std::unique_ptr<utils::Message> makeSendMsgUsrMessage(CommonHeader commonHeader, QTcpSocket &socket) {
+    template <class MessageT>
+    utils::AnyMessage decodeAny(CommonHeader commonHeader, void const *pData) {
         LOG_SCOPE;
-        return makeSendMessage<utils::SendMsgUsrMessage>(commonHeader, socket);
+        return decode<MessageT>(commonHeader, pData);
     }
 
-    std::unique_ptr<utils::Message> makeReqHeartbeatMessage(CommonHeader commonHeader, QTcpSocket &/*socket*/) {
+    using Decoder = utils::AnyMessage(*)(CommonHeader, void const *);
+
+    // one decoder per entry of MessageTypeList, at the index of its MessageType - 1
+    template <std::size_t... Indices>
+    constexpr std::array<Decoder, sizeof...(Indices)> makeDecoderTable(std::index_sequence<Indices...>) {
+        return std::array<Decoder, sizeof...(Indices)>{ { &decodeAny<utils::type_at_t<Indices, utils::MessageTypeList>>... } };
+    }
+
+    // returns the size of the username records following the common header or 0 if they're not all there yet.
+    // starts with the records progress has already been through and remembers how far it got for the next call.
+    std::size_t usernameRecordsSize(utils::Word amtRecords, char const *pData, std::size_t bytesAvailable,
+                                    func::ScanProgress &progress) {
         LOG_SCOPE;
-        return std::make_unique<utils::ReqHeartbeatMessage>(commonHeader.version, commonHeader.type, commonHeader.length);
+        auto offset = progress.bytesScanned;
+        auto i = progress.recordsScanned;
+        for (; i < amtRecords; ++i) {
+            if (bytesAvailable - offset < utils::usernameRecordStaticByteSize) {
+                break;
+            }
+
+            auto const lengthUserName = utils::wire::UsernameRecord::load<utils::wire::UsernameRecord::lengthUsername>(pData + offset);
+            auto const cbRecord = utils::usernameRecordStaticByteSize + utils::paddedUsernameLength(lengthUserName);
+            if (cbRecord > bytesAvailable - offset) {
+                break;
+            }
+            offset += cbRecord;
+        }
+
+        progress.recordsScanned = i;
+        progress.bytesScanned = offset;
+        return i == amtRecords ? offset : 0U;
     }
 
-    std::unique_ptr<utils::Message> makeResHeartbeatMessage(CommonHeader commonHeader, QTcpSocket &/*socket*/) {
+    // every record takes up at least its static part, which rules out record counts no frame can hold
+    bool isRecordCountTooLarge(utils::Word amtRecords, std::size_t cbStatic) {
         LOG_SCOPE;
-        return std::make_unique<utils::ResHeartbeatMessage>(commonHeader.version, commonHeader.type, commonHeader.length);
+        return amtRecords > (func::maxFrameSize - utils::commonHeaderByteSize - cbStatic) / utils::usernameRecordStaticByteSize;
     }
 
-    std::unique_ptr<utils::Message> makeErrorMsgNotDeliveredMessage(CommonHeader commonHeader, QTcpSocket &socket) {
+    FrameScan needMoreData() {
         LOG_SCOPE;
-        auto sendMsgStruct = makeSendMsgStruct(socket);
-        return std::make_unique<utils::ErrorMsgNotDeliveredMessage>(commonHeader.version, commonHeader.type, commonHeader.length, sendMsgStruct.messageId, sendMsgStruct.sourceIp, sendMsgStruct.targetIp, sendMsgStruct.sourcePort, sendMsgStruct.targetPort);
+        return FrameScan{ DecodeStatus::NeedMoreData, 0U, nullptr };
     }
 
+    FrameScan malformed(char const *error) {
+        LOG_SCOPE;
+        return FrameScan{ DecodeStatus::Malformed, 0U, error };
+    }
+
+    // the records of a client list aren't all there yet; that's only fine as long as the frame can still be small enough
+    FrameScan recordsIncomplete(std::size_t cbScanned) {
+        LOG_SCOPE;
+        if (cbScanned > func::maxFrameSize - utils::commonHeaderByteSize) {
+            return malformed("the username records were larger than the largest frame in scanFrame");
+        }
+        return needMoreData();
+    }
 } // END of anonymous namespace  
 
 namespace func {
-    std::unique_ptr<utils::Message> makeMessage(QTcpSocket &socket) {
+    FrameScan scanFrame(char const *data, std::size_t size, ScanProgress *progress) {
+        LOG_SCOPE;
+        if (size < utils::commonHeaderByteSize) {
+            return needMoreData();
+        }
+
+        ScanProgress fromScratch{ };
+        auto &recordProgress = progress != nullptr ? *progress : fromScratch;
+        auto const commonHeader = readCommonHeader(data);
+        auto const body = data + utils::commonHeaderByteSize;
+        auto const bodyBytesAvailable = size - utils::commonHeaderByteSize;
+        std::size_t cbBody = 0U;
+
+        switch (commonHeader.type) {
+            case utils::MessageType::reqFindServer :
+            case utils::MessageType::resFindServer :
+            case utils::MessageType::reqHeartbeat :
+            case utils::MessageType::resHeartbeat :
+            case utils::MessageType::reqClientList : {
+                break;
+            }
+            case utils::MessageType::reqLogin : {
+                if (commonHeader.length > maxiMumUserNameLength) {
+                    return malformed("length was too large in scanFrame");
+                }
+                cbBody = commonHeader.length;
+                break;
+            }
+            case utils::MessageType::updateClientList : {
+                if (isRecordCountTooLarge(commonHeader.length, 0U)) {
+                    return malformed("too many username records in scanFrame");
+                }
+                cbBody = usernameRecordsSize(commonHeader.length, body, bodyBytesAvailable, recordProgress);
+                if (cbBody == 0U && commonHeader.length != 0U) {
+                    return recordsIncomplete(recordProgress.bytesScanned);
+                }
+                break;
+            }
+            case utils::MessageType::updateClientListDelta : {
+                if (bodyBytesAvailable < utils::clientListDeltaStaticByteSize) {
+                    return needMoreData();
+                }
+                auto const amtAdded = utils::wire::ClientListDelta::load<utils::wire::ClientListDelta::amtAdded>(body);
+                if (amtAdded > commonHeader.length) {
+                    return malformed("more added records than records in scanFrame");
+                }
+                if (isRecordCountTooLarge(commonHeader.length, utils::clientListDeltaStaticByteSize)) {
+                    return malformed("too many username records in scanFrame");
+                }
+                auto const cbRecords = usernameRecordsSize(commonHeader.length, body + utils::clientListDeltaStaticByteSize,
+                                                           bodyBytesAvailable - utils::clientListDeltaStaticByteSize, recordProgress);
+                if (cbRecords == 0U && commonHeader.length != 0U) {
+                    return recordsIncomplete(utils::clientListDeltaStaticByteSize + recordProgress.bytesScanned);
+                }
+                cbBody = utils::clientListDeltaStaticByteSize + cbRecords;
+                break;
+            }
+            case utils::MessageType::sendMsgGrp :
+            case utils::MessageType::sendMsgUsr : {
+                if (commonHeader.length < utils::sendMsgStructByteSize) {
+                    return malformed("length was smaller than the send message struct in scanFrame");
+                }
+                if (commonHeader.length > maxFrameSize - utils::commonHeaderByteSize) {
+                    return malformed("length was larger than the largest frame in scanFrame");
+                }
+                cbBody = commonHeader.length;
+                break;
+            }
+            case utils::MessageType::errorMsgNotDelivered : {
+                cbBody = utils::sendMsgStructByteSize;
+                break;
+            }
+            default : return malformed("unrecognized MessageType in scanFrame");
+        } // END switch (commonHeader.type)
+
+        if (utils::commonHeaderByteSize + cbBody > maxFrameSize) { // the names of a client list made it too large
+            return malformed("the frame was larger than the largest frame in scanFrame");
+        }
+        if (bodyBytesAvailable < cbBody) {
+            return needMoreData();
+        }
+        return FrameScan{ DecodeStatus::Complete, utils::commonHeaderByteSize + cbBody, nullptr };
+    }
+
+    DecodeResult decodeFrame(char const *data, std::size_t size) {
         LOG_SCOPE;
-        static std::array<std::unique_ptr<utils::Message>(*)(CommonHeader, QTcpSocket &), utils::amtMessageTypes> functions{ &makeReqFindServerMessage, &makeResFindServerMessage,
-            &makeReqLoginMessage, &makeUpdateClientListMessage, &makeSendMsgGrpMessage,
-            &makeSendMsgUsrMessage, &makeReqHeartbeatMessage, &makeResHeartbeatMessage,
-            &makeErrorMsgNotDeliveredMessage
-        };
+        static auto constexpr decoders = makeDecoderTable(std::make_index_sequence<utils::amtMessageTypes>{ });
 
-        auto bytes = readFromSocket(utils::commonHeaderByteSize, socket);
-        void const *pData = bytes.constData();
+        auto const scan = scanFrame(data, size);
+        if (scan.status != DecodeStatus::Complete) {
+            return DecodeResult{ scan.status, 0U, std::nullopt, scan.error };
+        }
 
-        auto version = utils::readFromAddress<utils::Word>(pData);
-        utils::advancePtr(pData, sizeof(utils::Word));
+        auto const commonHeader = readCommonHeader(data); // scanFrame has vouched for the type, so the index is in range
         using MessageTypeType = std::underlying_type_t<utils::MessageType>;
-        auto type = static_cast<utils::MessageType>(utils::readFromAddress<MessageTypeType>(pData));
-        utils::advancePtr(pData, sizeof(MessageTypeType));
-        auto length = utils::readFromAddress<utils::Word>(pData);
-        utils::advancePtr(pData, sizeof(utils::Word));
-        // read common header
+        auto const decoder = decoders[static_cast<std::size_t>(static_cast<MessageTypeType>(commonHeader.type) - 1)];
+        return DecodeResult{ DecodeStatus::Complete, scan.frameSize, decoder(commonHeader, data + utils::commonHeaderByteSize), nullptr };
+    }
+
+    std::size_t frameSize(char const *data, std::size_t size) {
+        LOG_SCOPE;
+        auto const scan = scanFrame(data, size);
+        if (scan.status == DecodeStatus::Malformed) {
+            throw std::logic_error{ scan.error };
+        }
+        return scan.status == DecodeStatus::Complete ? scan.frameSize : 0U;
+    }
+
+    utils::AnyMessage makeMessage(char const *frame, std::size_t size) {
+        LOG_SCOPE;
+        auto result = decodeFrame(frame, size);
+        if (result.status == DecodeStatus::Complete) {
+            return std::move(*result.message);
+        }
 
-        return functions.at(static_cast<std::size_t>(static_cast<MessageTypeType>(type) - 1))(CommonHeader{ version, type, length }, socket);
+        metrics::decodeFailures().add();
+        throw std::logic_error{ result.status == DecodeStatus::Malformed ? result.error
+                                                                          : "frame was incomplete in makeMessage" };
     }
 } // END of namespace func
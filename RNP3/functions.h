@@ -2,9 +2,55 @@
 #include "Utility.h"
 #include "Types.h"
 #include <cstddef>
-#include <memory>
-#include <QTcpSocket>
+#include <climits>
+#include <optional>
 
 namespace func {
-    std::unique_ptr<utils::Message> makeMessage(QTcpSocket &socket);
+    enum class DecodeStatus {
+        Complete,
+        NeedMoreData, // nothing is wrong with the bytes so far, there just aren't enough of them yet
+        Malformed // the stream can't be resynchronized from here on
+    }; // END of enum class DecodeStatus
+
+    struct FrameScan final {
+        using this_type = FrameScan;
+        DecodeStatus status;
+        std::size_t frameSize; // the bytes the frame takes up, if it's Complete
+        char const *error; // what's wrong, if it's Malformed
+    }; // END of struct FrameScan
+
+    // how far scanFrame has got with the username records of a frame that isn't complete yet, so that it picks up
+    // where it left off once more bytes have come in instead of walking a large client list from the start every time.
+    // it belongs to the frame it was first handed in with; start over with a fresh one for the next frame.
+    struct ScanProgress final {
+        using this_type = ScanProgress;
+        std::size_t recordsScanned = 0U;
+        std::size_t bytesScanned = 0U; // the size of those records
+    }; // END of struct ScanProgress
+
+    struct DecodeResult final {
+        using this_type = DecodeResult;
+        DecodeStatus status;
+        std::size_t bytesConsumed; // 0 unless the message is Complete
+        std::optional<utils::AnyMessage> message; // set if the message is Complete
+        char const *error; // what's wrong, if it's Malformed
+    }; // END of struct DecodeResult
+
+    // the largest frame the codec accepts, header included. larger frames are Malformed, so a peer can't make a receive
+    // buffer grow without bound by announcing a huge message, and every frame fits the int sizes of QByteArray.
+    std::size_t constexpr maxFrameSize = std::size_t{ 16U } << 20U;
+    static_assert(maxFrameSize <= INT_MAX, "frames must fit into a QByteArray");
+
+    // the codec proper: pure functions over a contiguous range of bytes. they neither read nor write anything
+    // but the bytes (and the progress) handed in and don't throw on bad input, so they work the same for bytes
+    // from a socket, a file, a shared memory ring or a test buffer.
+    FrameScan scanFrame(char const *data, std::size_t size, ScanProgress *progress = nullptr); // finds out how long the frame starting at data is
+    DecodeResult decodeFrame(char const *data, std::size_t size); // decodes the frame starting at data
+
+    // the same for callers that would rather deal with exceptions; both throw std::logic_error on malformed input.
+    // returns the total size of the frame starting at data or 0 if more bytes are needed to tell
+    std::size_t frameSize(char const *data, std::size_t size);
+
+    // decodes a complete frame of exactly frameSize(frame, size) bytes
+    utils::AnyMessage makeMessage(char const *frame, std::size_t size);
 } // END of namespace func
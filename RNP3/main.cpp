@@ -2,15 +2,37 @@
 #include <QtWidgets/QApplication>
 #include "server.h"
 #include "Logger.h"
+#include "Profiler.h"
+#include "Metrics.h"
+#include "MetricsExport.h"
+#include <memory>
 
 int main(int argc, char *argv[]) {
     SET_LOG_LEVEL_DEBUG;
+    auto const traceFile = qgetenv("RNP3_TRACE"); // capture a Chrome trace of the whole run into this file
+    if (!traceFile.isEmpty()) {
+        profiling::Profiler::getProfiler().startCapture();
+    }
     LOG_SCOPE;
     static auto constexpr port = static_cast<qint16>(31337);
+    static auto constexpr adminPort = static_cast<quint16>(31338); // the metrics, for this machine only
+    static auto constexpr metricsDumpInterval = 10000; // ms
     QApplication application{ argc, argv };
     app::Server server{ port };
     server.activateServer();
+    app::AdminEndpoint adminEndpoint{ metrics::Registry::getRegistry() };
+    adminEndpoint.listenLocally(adminPort);
+    auto const metricsFile = qgetenv("RNP3_METRICS_FILE"); // dump the metrics into this file every now and then
+    std::unique_ptr<app::MetricsDumper> metricsDumper{ };
+    if (!metricsFile.isEmpty()) {
+        metricsDumper = std::make_unique<app::MetricsDumper>(metrics::Registry::getRegistry(), QString::fromLocal8Bit(metricsFile),
+                                                             metricsDumpInterval);
+    }
     gui::RNP3 mainWindow{ port };
     mainWindow.show();    
-    return application.exec();
+    auto const exitCode = application.exec();
+    if (!traceFile.isEmpty() && !profiling::Profiler::getProfiler().stopCapture(traceFile.toStdString())) {
+        LOG_ERROR << "couldn't write the trace to " << traceFile.toStdString() << '\n';
+    }
+    return exitCode;
 } // END of main
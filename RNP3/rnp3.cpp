@@ -12,7 +12,7 @@ namespace gui {
                 this, SLOT(drawResponse(QString)));
 
         utils::SendMsgUsrMessage msg{ 5, utils::MessageType::sendMsgUsr, 22, 1, 0, 0, 0, 0, "Hallo" };
-        auto bA = msg.toByteArray(); // TODO: this shit is big endian for no reason; fuck you!!!!
+        auto bA = msg.toByteArray(); // the fields are in network byte order, see WireFormat.h
         client_.writeToSocket(bA); // TODO: move this to gui
     }
 
@@ -1,11 +1,44 @@
 ﻿#include "server.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
 #include "Other.h"
 #include "Logger.h"
+#include "MessageViews.h"
 
 namespace app {
-    Server::Server(qint16 port, QObject *parent)
-        : QTcpServer{ parent }, port_{ port } {
+    Server::Server(qint16 port, int ioThreadCount, int shardCount, int workerCount, QObject *parent)
+        : QTcpServer{ parent }, ioThreads_{ shardCount > 0 ? shardCount : ioThreadCount },
+          heartbeatSettings_{ HeartbeatMonitor::defaultSettings }, heartbeatMonitors_{ },
+          workers_{ shardCount > 0 ? 0 : workerCount }, // the shards dispatch on their own threads
+          rosterVersion_{ utils::UpdateClientListDeltaMessage::fullRoster }, isStopping_{ false },
+          nextShard_{ 0U }, port_{ port }, sendLimits_{ ClientManager::defaultSendLimits }, framesDispatched_{ },
+          dispatchLatency_{ metrics::Registry::getRegistry().histogram("rnp3_dispatch_latency_ns",
+                                                                       "Time spent handling one received frame.") },
+          metricsCollector_{ } {
         LOG_SCOPE;
+        qRegisterMetaType<utils::Frame>("utils::Frame");
+        for (std::size_t i = 0U; i < framesDispatched_.size(); ++i) {
+            auto const type = static_cast<utils::MessageType>(i + 1U);
+            framesDispatched_[i] = &metrics::Registry::getRegistry().counter(
+                "rnp3_frames_dispatched_total", "Received frames handed to the dispatcher, by message type.",
+                "type=\"" + std::string{ utils::getName(type) } + '"');
+        }
+        metricsCollector_ = metrics::Registry::getRegistry().addCollector([this](std::ostream &out) {
+            collectMetrics(out);
+        });
+        for (int i = 0; i < shardCount; ++i) {
+            shards_.push_back(std::make_unique<Shard>(i, *this, ioThreads_.at(i)));
+        }
+    }
+
+    Server::~Server() {
+        LOG_SCOPE;
+        metrics::Registry::getRegistry().removeCollector(metricsCollector_);
+        isStopping_ = true; // nobody is left to tell about the users that go away from here on
+        ioThreads_.stop(); // nothing is read anymore, so no drain is scheduled from here on; no shard may be running either
+        workers_.stop(); // finishes the drains that are in flight while everything they touch is still alive
+        shards_.clear(); // the shards unregister their connections, so this has to happen while connections_ is still alive
     }
 
     qint16 Server::getPort() const {
@@ -13,77 +46,346 @@ namespace app {
         return port_;
     }
 
+    void Server::setSendLimits(ClientManager::SendLimits sendLimits) {
+        LOG_SCOPE;
+        sendLimits_ = sendLimits;
+    }
+
+    ClientManager::SendLimits Server::getSendLimits() const {
+        LOG_SCOPE;
+        return sendLimits_;
+    }
+
+    void Server::setHeartbeatSettings(HeartbeatMonitor::Settings settings) {
+        LOG_SCOPE;
+        heartbeatSettings_ = settings;
+    }
+
+    HeartbeatMonitor *Server::getHeartbeatMonitor(QThread *ioThread) const {
+        LOG_SCOPE;
+        auto const it = heartbeatMonitors_.find(ioThread);
+        return it == std::end(heartbeatMonitors_) ? nullptr : it->second.get();
+    }
+
     void Server::activateServer() {
-        listen(QHostAddress::Any, port_);
+        LOG_SCOPE;
+        if (heartbeatSettings_.interval > 0) { // only read from here on, so any thread may look the monitors up
+            for (auto i = 0; i < ioThreads_.size(); ++i) {
+                heartbeatMonitors_.emplace(ioThreads_.at(i), std::make_unique<HeartbeatMonitor>(ioThreads_.at(i), heartbeatSettings_));
+            }
+        }
+        if (shards_.empty()) {
+            listen(QHostAddress::Any, port_);
+            return;
+        }
+
+        for (auto &shard : shards_) {
+            shard->listen(static_cast<quint16>(port_));
+        }
     }
 
-    void Server::incomingConnection(qintptr socketDescriptor) {
+    void Server::registerConnection(ClientManager::Pointer const &clientManager, Shard *shard, QThread *ioThread) {
         LOG_SCOPE;
-        clientManagers_.push_back(std::make_unique<ClientManager>(socketDescriptor));
-        connect(clientManagers_.back().get(), SIGNAL(gotDataSignal(utils::Message *)),
-                this, SLOT(receiveData(utils::Message *)), Qt::QueuedConnection);
+        auto isAdded = false;
+        {
+            Lock lock{ connectionsMutex_ };
+            isAdded = connections_.emplace(clientManager.get(), Connection{ clientManager, shard, ioThread }).second;
+        }
+        if (isAdded) { // not under connectionsMutex_: rendering the metrics takes the locks the other way around
+            metrics::activeConnections().add(1);
+        }
     }
 
-    void Server::receiveData(utils::Message *message) const {
+    void Server::unregisterConnection(ClientManager *clientManager) {
         LOG_SCOPE;
-        auto clientManager = qobject_cast<ClientManager *>(sender());
-        if (clientManager == nullptr) {
-            LOG_ERROR << "downcast in Server::receiveData failed\n";
+        {
+            Lock rosterLock{ rosterMutex_ };
+            auto record = directory_.remove(clientManager);
+            if (record && !isStopping_) {
+                auto const baseVersion = rosterVersion_;
+                nextRosterVersion();
+                broadcastRosterChange(baseVersion, { }, { std::move(*record) }, nullptr);
+            }
+        }
+        auto isRemoved = false;
+        {
+            Lock lock{ connectionsMutex_ };
+            isRemoved = connections_.erase(clientManager) > 0U;
+        }
+        if (isRemoved) {
+            metrics::activeConnections().add(-1);
+        }
+    }
+
+    Shard *Server::nextShard() {
+        LOG_SCOPE;
+        if (shards_.empty()) {
+            return nullptr;
+        }
+        return shards_[nextShard_.fetch_add(1U, std::memory_order_relaxed) % shards_.size()].get();
+    }
+
+    std::optional<Server::Connection> Server::findConnection(ClientManager &clientManager) const {
+        LOG_SCOPE;
+        Lock lock{ connectionsMutex_ };
+        auto const it = connections_.find(&clientManager);
+        if (it == std::end(connections_)) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    void Server::login(ClientManager &source, std::string username) {
+        LOG_SCOPE;
+        auto const connection = findConnection(source);
+        if (!connection) {
+            LOG_ERROR << "Server::login: got a login from a connection that isn't registered\n";
             return;
         }
 
-        auto finalAction = utils::finally([message] {
-                                              delete message;
-                                          });
+        auto const info = source.getClientInfo();
+        auto const ip = info.clientAddress.toIPv4Address();
+        auto const port = static_cast<utils::HalfWord>(info.clientPort);
+        Lock rosterLock{ rosterMutex_ };
+        std::optional<utils::UsernameRecord> previous{ };
+        if (!directory_.add(*connection, ip, port, username, previous)) { // the user keeps the name they had, if any
+            LOG_DEBUG << "Server::login: the username " << username << " is already taken\n";
+            sendRoster(*connection); // there's no error message for this, the unchanged roster tells the client it isn't on it
+            return;
+        }
 
-        std::type_index typeIndex{ typeid(*message) };
-        auto it = utils::rttiTable.find(typeIndex);
-        if (it == std::end(utils::rttiTable)) {
-            throw std::logic_error{ "typeIndex not found in rttiTable in IncomingMessageHandler::readyReadSlot" };
+        std::vector<utils::UsernameRecord> removed{ };
+        if (previous) { // logging in again renames the user
+            removed.push_back(std::move(*previous));
+        }
+        std::vector<utils::UsernameRecord> added{ };
+        added.emplace_back(ip, port, static_cast<utils::Byte>(username.size()), std::move(username));
+        auto const baseVersion = rosterVersion_;
+        nextRosterVersion();
+        sendRoster(*connection); // the full roster goes to the one who logged in, everyone else only gets the change
+        broadcastRosterChange(baseVersion, std::move(added), std::move(removed), &source);
+    }
 
+    utils::Word Server::nextRosterVersion() {
+        LOG_SCOPE;
+        if (++rosterVersion_ == utils::UpdateClientListDeltaMessage::fullRoster) { // 0 is reserved for the full roster
+            ++rosterVersion_;
         }
-        auto messageType = it->second;
-        switch (messageType) { // TODO: respond to messages
-            case utils::MessageType::reqFindServer : {
-                auto p = static_cast<utils::ReqFindServerMessage *>(message);
-                break;
-            }
-            case utils::MessageType::resFindServer : {
-                auto p = static_cast<utils::ResFindServerMessage *>(message);
-                break;
-            }
-            case utils::MessageType::reqLogin : {
-                auto p = static_cast<utils::ReqLoginMessage *>(message);
-                break;
-            }
-            case utils::MessageType::updateClientList : {
-                auto p = static_cast<utils::UpdateClientListMessage *>(message);
-                break;
-            }
-            case utils::MessageType::sendMsgGrp : {
-                auto p = static_cast<utils::SendMsgGrpMessage *>(message);
-                break;
-            }
-            case utils::MessageType::sendMsgUsr : {
-                auto p = static_cast<utils::SendMsgUsrMessage *>(message);
-                clientManager->writeToSocket(p->toByteArray());
-                break;
-            }
-            case utils::MessageType::reqHeartbeat : {
-                auto p = static_cast<utils::ReqHeartbeatMessage *>(message);
-                break;
+        return rosterVersion_;
+    }
+
+    void Server::sendRoster(Connection const &target) const {
+        LOG_SCOPE;
+        auto records = directory_.getRecords();
+        auto const amtRecords = static_cast<utils::Word>(records.size());
+        utils::UpdateClientListDeltaMessage const roster{ utils::protocolVersion, utils::MessageType::updateClientListDelta, amtRecords,
+                                                          utils::UpdateClientListDeltaMessage::fullRoster, rosterVersion_,
+                                                          std::move(records), { } };
+        auto const bytes = roster.toByteArray();
+        // the same way as the deltas, or it could overtake one that has been posted but not written yet
+        FanOut::broadcast(utils::Frame{ bytes, 0, bytes.size() }, { target });
+    }
+
+    void Server::broadcastRosterChange(utils::Word baseVersion, std::vector<utils::UsernameRecord> added,
+                                       std::vector<utils::UsernameRecord> removed, ClientManager *except) const {
+        LOG_SCOPE;
+        auto const amtRecords = static_cast<utils::Word>(added.size() + removed.size());
+        utils::UpdateClientListDeltaMessage const delta{ utils::protocolVersion, utils::MessageType::updateClientListDelta, amtRecords,
+                                                         baseVersion, rosterVersion_, std::move(added), std::move(removed) };
+        auto const bytes = delta.toByteArray();
+
+        FanOut::Recipients recipients{ };
+        for (auto &connection : directory_.getConnections()) {
+            if (connection.clientManager.get() != except) {
+                recipients.push_back(std::move(connection));
             }
-            case utils::MessageType::resHeartbeat : {
-                auto p = static_cast<utils::ResHeartbeatMessage *>(message);
-                break;
+        }
+        // posted while rosterMutex_ is held, so every I/O thread sees the deltas in the order of their versions
+        FanOut::broadcast(utils::Frame{ bytes, 0, bytes.size() }, recipients);
+    }
+
+    void Server::reportNotDelivered(ClientManager &source, utils::SendMessageView const &view) const {
+        LOG_SCOPE;
+        utils::ErrorMsgNotDeliveredMessage const error{ view.getFrame().getVersion(), utils::MessageType::errorMsgNotDelivered,
+                                                        utils::sendMsgStructByteSize, view.getMessageId(),
+                                                        view.getSourceIp(), view.getTargetIp(),
+                                                        view.getSourcePort(), view.getTargetPort() };
+        source.writeToSocket(error.toByteArray());
+    }
+
+    void Server::deliver(Connection const &target, utils::Frame frame) const {
+        LOG_SCOPE;
+        if (target.shard != nullptr && target.thread != QThread::currentThread()) {
+            target.shard->post(target.clientManager, std::move(frame)); // the connection belongs to another shard
+        } else {
+            target.clientManager->writeToSocket(frame); // target holds a reference, so it can't be destroyed meanwhile
+        }
+    }
+
+    FanOut::Recipients Server::getRecipients() const {
+        LOG_SCOPE;
+        Lock lock{ connectionsMutex_ };
+        FanOut::Recipients recipients{ };
+        recipients.reserve(connections_.size());
+        for (auto const &pair : connections_) {
+            recipients.push_back(pair.second); // keeps the connection alive until the FanOut has written to it
+        }
+        return recipients;
+    }
+
+    void Server::incomingConnection(qintptr socketDescriptor) {
+        LOG_SCOPE;
+        auto const ioThread = ioThreads_.next();
+        clientManagers_.push_back(ClientManager::Pointer{ new ClientManager{ ioThread, sendLimits_, getHeartbeatMonitor(ioThread) },
+                                                          ClientManager::Deleter{ } });
+        auto const clientManager = clientManagers_.back().get();
+        registerConnection(clientManagers_.back(), nullptr, ioThread);
+        connect(clientManager, SIGNAL(inboxReadySignal(app::ClientManager *)),
+                this, SLOT(scheduleDrainSlot(app::ClientManager *)), Qt::DirectConnection); // don't detour via the GUI thread
+        connect(clientManager, SIGNAL(disconnectedSignal()),
+                this, SLOT(clientDisconnectedSlot()), Qt::QueuedConnection);
+        clientManager->start(socketDescriptor);
+    }
+
+    void Server::clientDisconnectedSlot() {
+        LOG_SCOPE;
+        auto clientManager = qobject_cast<ClientManager *>(sender());
+        unregisterConnection(clientManager);
+        auto it = std::find_if(std::begin(clientManagers_), std::end(clientManagers_),
+                               [clientManager](ClientManager::Pointer const &p) {
+                                   return p.get() == clientManager;
+                               });
+        if (it != std::end(clientManagers_)) {
+            clientManagers_.erase(it);
+        }
+    }
+
+    void Server::scheduleDrainSlot(app::ClientManager *clientManager) {
+        LOG_SCOPE;
+        // only one drain per connection is ever in flight (see ClientManager), so a connection's frames are handled in order
+        // while different connections are handled in parallel by whichever workers are free.
+        workers_.submit([this, clientManager] {
+            drainInbox(*clientManager);
+        });
+    }
+
+    void Server::drainInbox(ClientManager &clientManager) {
+        LOG_SCOPE;
+        clientManager.drainInbox([this, &clientManager](utils::Frame frame) {
+            try {
+                dispatch(clientManager, std::move(frame));
+            } catch (std::logic_error const &ex) {
+                metrics::decodeFailures().add();
+                LOG_DEBUG << "Caught logic_error in Server::drainInbox:\n" << ex.what() << '\n';
+            } catch (...) { // must not escape, or the connection's drain never finishes
+                LOG_ERROR << "Unknown exception caught in Server::drainInbox\n";
             }
-            case utils::MessageType::errorMsgNotDelivered : {
-                auto p = static_cast<utils::ErrorMsgNotDeliveredMessage *>(message);
-                break;
+        });
+    }
+
+    std::size_t Server::getInboxDepth() const {
+        LOG_SCOPE;
+        Lock lock{ connectionsMutex_ };
+        std::size_t depth = 0U;
+        for (auto const &pair : connections_) {
+            depth += pair.first->getInboxDepth();
+        }
+        return depth;
+    }
+
+    void Server::dispatch(ClientManager &source, utils::Frame frame) {
+        LOG_SCOPE;
+        auto const typeIndex = static_cast<std::size_t>(frame.getType()) - 1U; // wraps around for a type of 0
+        if (typeIndex < framesDispatched_.size()) {
+            framesDispatched_[typeIndex]->add();
+        }
+
+        auto const start = std::chrono::steady_clock::now();
+        utils::visitFrame(std::move(frame), [this, &source](auto const &view) {
+            handle(source, view);
+        });
+        auto const elapsed = std::chrono::steady_clock::now() - start;
+        dispatchLatency_.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    void Server::collectMetrics(std::ostream &out) const {
+        LOG_SCOPE;
+        out << "# HELP rnp3_inbox_depth Frames received but not dispatched yet, over all connections.\n"
+            << "# TYPE rnp3_inbox_depth gauge\n"
+            << "rnp3_inbox_depth " << getInboxDepth() << '\n';
+
+        std::vector<std::pair<std::string, ClientManager::Stats>> connections{ };
+        {
+            Lock lock{ connectionsMutex_ };
+            connections.reserve(connections_.size());
+            for (auto const &pair : connections_) {
+                auto const info = pair.first->getClientInfo();
+                connections.emplace_back("peer=\"" + info.clientAddress.toString().toStdString() + ':'
+                                         + std::to_string(static_cast<quint16>(info.clientPort)) + '"',
+                                         pair.first->getStats());
             }
-            default : throw std::logic_error{ "unrecognized MessageType in IncomingMessageHandler::readyReadSlot" };
-        } // END switch (messageType)
-        
-    } // END void Server::receiveData(utils::Message *message)
+        }
+
+        out << "# HELP rnp3_connection_bytes_received_total Bytes read from one client.\n"
+            << "# TYPE rnp3_connection_bytes_received_total counter\n";
+        for (auto const &connection : connections) {
+            out << "rnp3_connection_bytes_received_total{" << connection.first << "} " << connection.second.bytesReceived << '\n';
+        }
+        out << "# HELP rnp3_connection_bytes_sent_total Bytes written to one client.\n"
+            << "# TYPE rnp3_connection_bytes_sent_total counter\n";
+        for (auto const &connection : connections) {
+            out << "rnp3_connection_bytes_sent_total{" << connection.first << "} " << connection.second.bytesSent << '\n';
+        }
+        out << "# HELP rnp3_connection_frames_received_total Frames received from one client.\n"
+            << "# TYPE rnp3_connection_frames_received_total counter\n";
+        for (auto const &connection : connections) {
+            out << "rnp3_connection_frames_received_total{" << connection.first << "} " << connection.second.framesReceived << '\n';
+        }
+        out << "# HELP rnp3_connection_bytes_queued Bytes written to one client but not handed to the kernel yet.\n"
+            << "# TYPE rnp3_connection_bytes_queued gauge\n";
+        for (auto const &connection : connections) {
+            out << "rnp3_connection_bytes_queued{" << connection.first << "} " << connection.second.bytesQueued << '\n';
+        }
+    }
+
+    void Server::handle(ClientManager &source, utils::ReqLoginView const &view) {
+        LOG_SCOPE;
+        login(source, std::string{ view.getUsername() });
+    }
+
+    void Server::handle(ClientManager &/*source*/, utils::SendMsgGrpView const &view) {
+        LOG_SCOPE;
+        FanOut::broadcast(view.getFrame().compacted(), getRecipients()); // don't pin the whole receive buffer
+    }
+
+    void Server::handle(ClientManager &source, utils::SendMsgUsrView const &view) {
+        LOG_SCOPE;
+        auto const target = directory_.findByAddress(view.getTargetIp(), view.getTargetPort());
+        if (!target) {
+            reportNotDelivered(source, view);
+            return;
+        }
+        deliver(*target, view.getFrame());
+    }
+
+    void Server::handle(ClientManager &source, utils::ReqClientListView const &/*view*/) { // the client missed a delta
+        LOG_SCOPE;
+        auto const connection = findConnection(source);
+        if (!connection) {
+            return;
+        }
+        Lock rosterLock{ rosterMutex_ };
+        sendRoster(*connection);
+    }
+
+    void Server::handle(ClientManager &source, utils::ReqHeartbeatView const &/*view*/) {
+        LOG_SCOPE;
+        source.writeToSocket(HeartbeatMonitor::responseFrame());
+    }
 
+    void Server::handle(ClientManager &source, utils::ReqFindServerView const &/*view*/) {
+        LOG_SCOPE;
+        utils::ResFindServerMessage const response{ utils::protocolVersion, utils::MessageType::resFindServer, 0U };
+        source.writeToSocket(response.toByteArray());
+    }
 } // END of namespace app
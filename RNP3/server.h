@@ -1,7 +1,25 @@
-﻿#include <QTcpServer>
+﻿#pragma once
+#include <QTcpServer>
 #include <vector>
+#include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <optional>
+#include <string>
+#include <array>
+#include <ostream>
+#include <QThread>
 #include "ClientManager.h"
+#include "HeartbeatMonitor.h"
+#include "IoThreadPool.h"
+#include "WorkStealingPool.h"
+#include "Shard.h"
+#include "Frame.h"
+#include "FanOut.h"
+#include "UserDirectory.h"
+#include "MessageViews.h"
+#include "Metrics.h"
 
 namespace app {
     class Server final : public QTcpServer {
@@ -10,20 +28,79 @@ namespace app {
     public:
         using this_type = Server;
         using Base = QObject;
-        using container_type = std::vector<std::unique_ptr<ClientManager>>;
-        
-        explicit Server(qint16 port, QObject *parent = nullptr);
+        using container_type = std::vector<ClientManager::Pointer>;
+        using Mutex = std::mutex;
+        using Lock = std::unique_lock<Mutex>;
+
+        using Connection = app::Connection;
+
+        // with a shardCount of 0 the server accepts on a single socket in the GUI thread and dispatches on a pool of
+        // workerCount worker threads; otherwise every shard gets its own event loop, listening socket and connections.
+        explicit Server(qint16 port, int ioThreadCount = QThread::idealThreadCount(), int shardCount = 0,
+                        int workerCount = QThread::idealThreadCount(), QObject *parent = nullptr);
+        ~Server();
         qint16 getPort() const;
+        void setSendLimits(ClientManager::SendLimits sendLimits); // for the connections accepted from here on; call it before activateServer
+        ClientManager::SendLimits getSendLimits() const;
+        void setHeartbeatSettings(HeartbeatMonitor::Settings settings); // call it before activateServer
+        HeartbeatMonitor *getHeartbeatMonitor(QThread *ioThread) const; // nullptr if the heartbeats are turned off
         void activateServer();
+        void dispatch(ClientManager &source, utils::Frame frame); // runs on the thread that received the frame
+        void registerConnection(ClientManager::Pointer const &clientManager, Shard *shard, QThread *ioThread);
+        void unregisterConnection(ClientManager *clientManager);
+        Shard *nextShard(); // hands out the shards round robin
+        std::size_t getInboxDepth() const; // the frames received but not dispatched yet, over all connections
 
-    public slots:
-        void receiveData(utils::Message *) const;
+    private slots:
+        void scheduleDrainSlot(app::ClientManager *clientManager); // called on the connection's I/O thread
+        void clientDisconnectedSlot();
 
     protected:
         virtual void incomingConnection(qintptr socketDescriptor) override;
 
     private:
+        void handle(ClientManager &source, utils::ReqLoginView const &view);
+        void handle(ClientManager &source, utils::SendMsgGrpView const &view);
+        void handle(ClientManager &source, utils::SendMsgUsrView const &view);
+        void handle(ClientManager &source, utils::ReqClientListView const &view);
+        void handle(ClientManager &source, utils::ReqHeartbeatView const &view);
+        void handle(ClientManager &source, utils::ReqFindServerView const &view);
+
+        // ResFindServer, UpdateClientList, UpdateClientListDelta and ErrorMsgNotDelivered only ever go from a server
+        // to a client, so a client that sends them is ignored. a ResHeartbeat needs no handling of its own:
+        // ClientManager counts any frame a client sends as a sign of life.
+        template <class View>
+        void handle(ClientManager &/*source*/, View const &/*view*/) { }
+
+        void drainInbox(ClientManager &clientManager); // runs on a worker
+        void collectMetrics(std::ostream &out) const; // the per-connection metrics, rendered when they're scraped
+        std::optional<Connection> findConnection(ClientManager &clientManager) const; // std::nullopt if it isn't registered
+        void login(ClientManager &source, std::string username);
+        void reportNotDelivered(ClientManager &source, utils::SendMessageView const &view) const;
+        void deliver(Connection const &target, utils::Frame frame) const;
+        FanOut::Recipients getRecipients() const; // everyone who is connected right now
+        utils::Word nextRosterVersion(); // has to be called with rosterMutex_ held
+        void sendRoster(Connection const &target) const; // has to be called with rosterMutex_ held
+        void broadcastRosterChange(utils::Word baseVersion, std::vector<utils::UsernameRecord> added,
+                                   std::vector<utils::UsernameRecord> removed, ClientManager *except) const; // same here
+
+        std::vector<std::unique_ptr<Shard>> shards_; // destroyed after their threads have been stopped
+        IoThreadPool ioThreads_; // has to outlive the client managers; these are the shards' threads in sharded mode
+        HeartbeatMonitor::Settings heartbeatSettings_;
+        std::unordered_map<QThread *, std::unique_ptr<HeartbeatMonitor>> heartbeatMonitors_; // one per I/O thread, made by activateServer
         container_type clientManagers_;
+        utils::WorkStealingPool workers_; // stopped right after the I/O threads in the destructor; the tasks use everything below
+        std::unordered_map<ClientManager *, Connection> connections_; // every connection, logged in or not
+        mutable Mutex connectionsMutex_;
+        UserDirectory directory_;
+        Mutex rosterMutex_; // keeps the roster versions and the order the deltas are sent out in in sync
+        utils::Word rosterVersion_;
+        std::atomic_bool isStopping_;
+        std::atomic<std::size_t> nextShard_;
         qint16 port_;
+        ClientManager::SendLimits sendLimits_;
+        std::array<metrics::Counter *, utils::amtMessageTypes> framesDispatched_; // by MessageType - 1
+        metrics::Histogram &dispatchLatency_;
+        metrics::Registry::CollectorId metricsCollector_;
     }; // END of class Server    
 } // END of namespace app
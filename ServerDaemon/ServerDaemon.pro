@@ -0,0 +1,60 @@
+# the headless server for Linux hosts: qmake && make
+TEMPLATE = app
+TARGET = ServerDaemon
+QT = core network
+CONFIG += console
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS += -std=c++17
+LIBS += -lpthread
+
+INCLUDEPATH += . ../RNP3
+
+HEADERS += \
+    SignalHandler.h \
+    ../RNP3/BufferPool.h \
+    ../RNP3/ClientManager.h \
+    ../RNP3/FanOut.h \
+    ../RNP3/Frame.h \
+    ../RNP3/FrameAssembler.h \
+    ../RNP3/functions.h \
+    ../RNP3/GatherList.h \
+    ../RNP3/HeartbeatMonitor.h \
+    ../RNP3/IoThreadPool.h \
+    ../RNP3/Logger.h \
+    ../RNP3/MessageViews.h \
+    ../RNP3/Metrics.h \
+    ../RNP3/MetricsExport.h \
+    ../RNP3/Profiler.h \
+    ../RNP3/server.h \
+    ../RNP3/Shard.h \
+    ../RNP3/SpscRing.h \
+    ../RNP3/TimerWheel.h \
+    ../RNP3/Types.h \
+    ../RNP3/UserDirectory.h \
+    ../RNP3/Utility.h \
+    ../RNP3/WireFormat.h \
+    ../RNP3/WorkStealingPool.h
+
+SOURCES += \
+    main.cpp \
+    SignalHandler.cpp \
+    ../RNP3/BufferPool.cpp \
+    ../RNP3/ClientManager.cpp \
+    ../RNP3/FanOut.cpp \
+    ../RNP3/Frame.cpp \
+    ../RNP3/FrameAssembler.cpp \
+    ../RNP3/functions.cpp \
+    ../RNP3/GatherList.cpp \
+    ../RNP3/HeartbeatMonitor.cpp \
+    ../RNP3/IoThreadPool.cpp \
+    ../RNP3/Logger.cpp \
+    ../RNP3/MessageViews.cpp \
+    ../RNP3/Metrics.cpp \
+    ../RNP3/MetricsExport.cpp \
+    ../RNP3/Profiler.cpp \
+    ../RNP3/server.cpp \
+    ../RNP3/Shard.cpp \
+    ../RNP3/TimerWheel.cpp \
+    ../RNP3/Types.cpp \
+    ../RNP3/UserDirectory.cpp \
+    ../RNP3/WorkStealingPool.cpp
@@ -0,0 +1,76 @@
+#include "SignalHandler.h"
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include "Logger.h"
+#ifdef Q_OS_UNIX
+#   include <csignal>
+#   include <sys/socket.h>
+#   include <unistd.h>
+#elif defined(Q_OS_WIN)
+#   include <windows.h>
+#endif
+
+namespace {
+#ifdef Q_OS_UNIX
+    int signalFds[2] = { -1, -1 }; // the handler writes to [0], the event loop reads from [1]
+
+    extern "C" void onSignal(int) {
+        char const byte = 1;
+        static_cast<void>(::write(signalFds[0], &byte, sizeof(byte)));
+    }
+#elif defined(Q_OS_WIN)
+    BOOL WINAPI onConsoleEvent(DWORD) { // runs on a thread of its own, not in a signal context
+        QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);
+        return TRUE;
+    }
+#endif
+} // END of anonymous namespace
+
+namespace headless {
+    SignalHandler::SignalHandler(QObject *parent)
+        : Base{ parent }, notifier_{ nullptr } {
+        LOG_SCOPE;
+#ifdef Q_OS_UNIX
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, signalFds) != 0) {
+            LOG_ERROR << "SignalHandler: couldn't create the socket pair; SIGINT and SIGTERM will kill the server outright\n";
+            return;
+        }
+        notifier_ = std::make_unique<QSocketNotifier>(signalFds[1], QSocketNotifier::Read);
+        connect(notifier_.get(), SIGNAL(activated(int)), this, SLOT(signalSlot()));
+
+        struct sigaction action{ };
+        action.sa_handler = &onSignal;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+#elif defined(Q_OS_WIN)
+        SetConsoleCtrlHandler(&onConsoleEvent, TRUE);
+#endif
+    }
+
+    SignalHandler::~SignalHandler() {
+        LOG_SCOPE;
+#ifdef Q_OS_UNIX
+        if (notifier_ != nullptr) {
+            std::signal(SIGINT, SIG_DFL);
+            std::signal(SIGTERM, SIG_DFL);
+            notifier_.reset();
+            ::close(signalFds[0]);
+            ::close(signalFds[1]);
+        }
+#elif defined(Q_OS_WIN)
+        SetConsoleCtrlHandler(&onConsoleEvent, FALSE);
+#endif
+    }
+
+    void SignalHandler::signalSlot() {
+        LOG_SCOPE;
+#ifdef Q_OS_UNIX
+        char byte = 0;
+        static_cast<void>(::read(signalFds[1], &byte, sizeof(byte)));
+#endif
+        LOG_WARNING << "got a signal, shutting down\n";
+        QCoreApplication::quit();
+    }
+} // END of namespace headless
@@ -0,0 +1,26 @@
+#pragma once
+#include <QObject>
+#include <memory>
+
+class QSocketNotifier;
+
+namespace headless {
+    // turns SIGINT and SIGTERM into a clean QCoreApplication::quit, so the server's destructor gets to
+    // stop its threads and the logger gets to flush. on Unix the handler only writes a byte to a socket pair,
+    // which is all that's safe to do in a signal handler; the event loop picks it up from there.
+    class SignalHandler final : public QObject {
+        Q_OBJECT
+    public:
+        using this_type = SignalHandler;
+        using Base = QObject;
+
+        explicit SignalHandler(QObject *parent = nullptr);
+        ~SignalHandler();
+
+    private slots:
+        void signalSlot();
+
+    private:
+        std::unique_ptr<QSocketNotifier> notifier_;
+    }; // END of class SignalHandler
+} // END of namespace headless
@@ -0,0 +1,150 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QThread>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include "server.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include "Metrics.h"
+#include "MetricsExport.h"
+#include "SignalHandler.h"
+
+// the server on its own: no widgets, no display and no client of its own, just a QCoreApplication running
+// the accepting socket. see ServerDaemon --help for the options.
+namespace {
+    struct Options final {
+        using this_type = Options;
+        quint16 port;
+        int ioThreads;
+        int shards;
+        int workers;
+        quint16 adminPort; // 0 turns the metrics endpoint off
+        QString metricsFile; // empty turns the dump off
+        int metricsInterval; // ms
+        QString traceFile; // empty unless a Chrome trace of the run is wanted
+        app::ClientManager::SendLimits sendLimits;
+        app::HeartbeatMonitor::Settings heartbeats;
+    }; // END of struct Options
+
+    bool setLogLevel(QString const &level) {
+        LOG_SCOPE;
+        if (level == "error") {
+            SET_LOG_LEVEL_ERROR;
+        } else if (level == "warning") {
+            SET_LOG_LEVEL_WARNING;
+        } else if (level == "debug") {
+            SET_LOG_LEVEL_DEBUG;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    bool parsePolicy(QString const &name, app::ClientManager::SlowConsumerPolicy &policy) {
+        LOG_SCOPE;
+        if (name == "drop") {
+            policy = app::ClientManager::SlowConsumerPolicy::DropChat;
+        } else if (name == "disconnect") {
+            policy = app::ClientManager::SlowConsumerPolicy::Disconnect;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    Options parseArguments(QCoreApplication const &application) {
+        LOG_SCOPE;
+        auto const idealThreads = QString::number(QThread::idealThreadCount());
+        QCommandLineParser parser{ };
+        parser.setApplicationDescription("Runs the RNP3 server without a GUI.");
+        parser.addHelpOption();
+        QCommandLineOption const port{ "port", "The port to accept clients on.", "port", "31337" };
+        QCommandLineOption const ioThreads{ "io-threads", "The threads the connections are spread over.", "n", idealThreads };
+        QCommandLineOption const shards{ "shards", "Independent event loops with a listening socket each; 0 for one accepting socket.", "n", "0" };
+        QCommandLineOption const workers{ "workers", "The threads the received frames are dispatched on, unless sharded.", "n", idealThreads };
+        QCommandLineOption const logLevel{ "log-level", "error, warning or debug.", "level", "warning" };
+        QCommandLineOption const adminPort{ "admin-port", "The local port the metrics are served on; 0 for none.", "port", "31338" };
+        QCommandLineOption const metricsFile{ "metrics-file", "The file the metrics are written to; empty for none.", "file", "" };
+        QCommandLineOption const metricsInterval{ "metrics-interval", "How often the metrics file is written, in ms.", "ms", "10000" };
+        QCommandLineOption const trace{ "trace", "Capture a Chrome trace of the whole run into this file.", "file", "" };
+        auto const defaults = app::ClientManager::defaultSendLimits;
+        QCommandLineOption const highWatermark{ "high-watermark", "Bytes waiting to be sent to one client before it counts as slow.",
+                                                "bytes", QString::number(defaults.highWatermark) };
+        QCommandLineOption const lowWatermark{ "low-watermark", "Bytes a slow client has to get down to before it gets chat messages again.",
+                                               "bytes", QString::number(defaults.lowWatermark) };
+        QCommandLineOption const serverSendLimit{ "server-send-limit", "Bytes waiting to be sent over all clients before the ones above the low watermark count as slow.",
+                                                  "bytes", QString::number(defaults.serverLimit) };
+        QCommandLineOption const slowConsumer{ "slow-consumer", "What happens to slow clients: drop (their chat messages) or disconnect.",
+                                               "policy", "drop" };
+        auto const heartbeatDefaults = app::HeartbeatMonitor::defaultSettings;
+        QCommandLineOption const heartbeatInterval{ "heartbeat-interval", "How long a client may be silent before it's sent a heartbeat, in ms; 0 for no heartbeats.",
+                                                    "ms", QString::number(heartbeatDefaults.interval) };
+        QCommandLineOption const missedHeartbeats{ "missed-heartbeats", "Unanswered heartbeats after which a client is disconnected.",
+                                                   "n", QString::number(heartbeatDefaults.missedLimit) };
+        parser.addOptions({ port, ioThreads, shards, workers, logLevel, adminPort, metricsFile, metricsInterval, trace,
+                            highWatermark, lowWatermark, serverSendLimit, slowConsumer, heartbeatInterval, missedHeartbeats });
+        parser.process(application);
+
+        if (!setLogLevel(parser.value(logLevel))) {
+            std::cerr << "unknown log level " << parser.value(logLevel).toStdString() << '\n';
+            std::exit(EXIT_FAILURE);
+        }
+        auto sendLimits = app::ClientManager::SendLimits{ static_cast<std::size_t>(parser.value(highWatermark).toULongLong()),
+                                                          static_cast<std::size_t>(parser.value(lowWatermark).toULongLong()),
+                                                          static_cast<std::size_t>(parser.value(serverSendLimit).toULongLong()),
+                                                          defaults.policy };
+        if (!parsePolicy(parser.value(slowConsumer), sendLimits.policy)) {
+            std::cerr << "unknown slow consumer policy " << parser.value(slowConsumer).toStdString() << '\n';
+            std::exit(EXIT_FAILURE);
+        }
+        sendLimits.lowWatermark = std::min(sendLimits.lowWatermark, sendLimits.highWatermark);
+
+        return Options{ static_cast<quint16>(parser.value(port).toUInt()), std::max(1, parser.value(ioThreads).toInt()),
+                        std::max(0, parser.value(shards).toInt()), std::max(1, parser.value(workers).toInt()),
+                        static_cast<quint16>(parser.value(adminPort).toUInt()), parser.value(metricsFile),
+                        std::max(1, parser.value(metricsInterval).toInt()), parser.value(trace), sendLimits,
+                        app::HeartbeatMonitor::Settings{ std::max(0, parser.value(heartbeatInterval).toInt()),
+                                                         std::max(1, parser.value(missedHeartbeats).toInt()) } };
+    }
+} // END of anonymous namespace
+
+int main(int argc, char *argv[]) {
+    LOG_SCOPE;
+    QCoreApplication application{ argc, argv };
+    QCoreApplication::setApplicationName("ServerDaemon");
+    auto const options = parseArguments(application);
+    if (!options.traceFile.isEmpty()) {
+        profiling::Profiler::getProfiler().startCapture();
+    }
+
+    headless::SignalHandler signalHandler{ };
+    app::Server server{ static_cast<qint16>(options.port), options.ioThreads, options.shards, options.workers };
+    server.setSendLimits(options.sendLimits);
+    server.setHeartbeatSettings(options.heartbeats);
+    server.activateServer();
+    if (options.shards == 0 && !server.isListening()) { // the shards report their own errors, they listen asynchronously
+        LOG_ERROR << "couldn't listen on port " << options.port << ": " << server.errorString().toStdString() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<app::AdminEndpoint> adminEndpoint{ };
+    if (options.adminPort != 0U) {
+        adminEndpoint = std::make_unique<app::AdminEndpoint>(metrics::Registry::getRegistry());
+        adminEndpoint->listenLocally(options.adminPort);
+    }
+    std::unique_ptr<app::MetricsDumper> metricsDumper{ };
+    if (!options.metricsFile.isEmpty()) {
+        metricsDumper = std::make_unique<app::MetricsDumper>(metrics::Registry::getRegistry(), options.metricsFile,
+                                                             options.metricsInterval);
+    }
+
+    LOG_DEBUG << "listening on port " << options.port << '\n';
+    auto const exitCode = application.exec();
+    if (!options.traceFile.isEmpty() && !profiling::Profiler::getProfiler().stopCapture(options.traceFile.toStdString())) {
+        LOG_ERROR << "couldn't write the trace to " << options.traceFile.toStdString() << '\n';
+    }
+    return exitCode;
+} // END of main